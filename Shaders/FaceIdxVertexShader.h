@@ -6,19 +6,22 @@
 
 static const char *face_idx_vertex_shader_source = SHADER_CODE_GLSL_TO_STRING(330,
     layout(location = 0) in vec3 a_pos;
-    layout(location = 1) in vec3 a_id; // a id of the face((r * 256^3 + g * 256^2 + b) * 256 - 1)
 
-    flat out vec3 vs_id; //flat/smooth/noperspective
-
-    uniform mat4 model;
-    uniform mat4 normal_matrix;
-    uniform mat4 view;
-    uniform mat4 projection;
+    // blocks are shared by all the programs, see Shader::UniformBlockBindings
+    layout(std140) uniform Transform
+    {
+        mat4 model;
+        mat4 normal_matrix;
+    };
+    layout(std140) uniform Camera
+    {
+        mat4 view;
+        mat4 projection;
+        vec4 eye_pos;
+    };
 
     void main()
     {
-        vs_id = a_id;
-
         // info for fragment shader
         vec3 vs_frag_position = vec3(model * vec4(a_pos, 1.0));
     
@@ -0,0 +1,17 @@
+#pragma once
+// Face visibility pass: bits of the faces are OR-ed into the R32UI target by the logic op
+
+#ifndef SHADER_CODE_GLSL_TO_STRING
+#define SHADER_CODE_GLSL_TO_STRING(version, shader)  "#version " #version " core \n" #shader  
+#endif
+
+static const char *face_visibility_fragment_shader_source = SHADER_CODE_GLSL_TO_STRING(330,
+    layout(location = 0) out uint frag_bits;
+
+    flat in uint vs_bit;
+
+    void main()
+    {
+        frag_bits = vs_bit;
+    }
+);
@@ -0,0 +1,34 @@
+#pragma once
+// Face visibility pass: one point per pixel of the face index image.
+// The point lands on the texel of the visibility bitset that holds the bit of the face
+
+#ifndef SHADER_CODE_GLSL_TO_STRING
+#define SHADER_CODE_GLSL_TO_STRING(version, shader)  "#version " #version " core \n" #shader  
+#endif
+
+static const char *face_visibility_vertex_shader_source = SHADER_CODE_GLSL_TO_STRING(330,
+    uniform usampler2D face_idx;
+    uniform int image_width;
+    // bitset texture: 32 faces per texel, bitsets of the cameras are stacked row-wise
+    uniform int target_width;
+    uniform int target_height;
+    uniform int first_row;  // of the current camera
+
+    flat out uint vs_bit;
+
+    void main()
+    {
+        uint face = texelFetch(face_idx, ivec2(gl_VertexID % image_width, gl_VertexID / image_width), 0).r;
+        int word = int(face >> 5u);
+        vs_bit = 1u << (face & 31u);
+
+        vec2 texel = vec2(word % target_width, first_row + word / target_width) + 0.5;
+        gl_Position = vec4(texel / vec2(target_width, target_height) * 2.0 - 1.0, 0.0, 1.0);
+
+        // background pixels (Frame::background_face_idx) go outside of the clip volume
+        if (face == 0xFFFFFFFFu)
+        {
+            gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        }
+    }
+);
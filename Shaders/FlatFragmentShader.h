@@ -7,14 +7,17 @@
 static const char *flat_fragment_shader_source = SHADER_CODE_GLSL_TO_STRING(330,
 
     // output color!
-    out vec4 frag_color;
+    layout(location = 0) out vec4 frag_color;
+    // index of the face in the draw call; written if the framebuffer has an integer attachment for it
+    layout(location = 1) out uint frag_face_idx;
 
-    // From Vertex shader
-    flat in vec3 vs_color;
+    // color of every face, looked up by the index of the face
+    uniform samplerBuffer face_attributes;
 
     // ------------------ main ---------------------
     void main()
     {
-        frag_color = vec4(vs_color, 1.0);
+        frag_color = vec4(texelFetch(face_attributes, gl_PrimitiveID).rgb, 1.0);
+        frag_face_idx = uint(gl_PrimitiveID);
     }
 );
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+// Renders the same geometry for several cameras at once: one instance == one camera == one layer of the texture array
+
+#ifndef SHADER_CODE_GLSL_TO_STRING_LAYERED
+#define SHADER_CODE_GLSL_TO_STRING_LAYERED(version, shader)  "#version " #version " core \n#extension GL_ARB_shader_viewport_layer_array : require \n" #shader  
+#endif
+
+static const char *flat_layered_vertex_shader_source = SHADER_CODE_GLSL_TO_STRING_LAYERED(330,
+    layout(location = 0) in vec3 a_pos;
+
+    // blocks are shared by all the programs, see Shader::UniformBlockBindings
+    layout(std140) uniform Transform
+    {
+        mat4 model;
+        mat4 normal_matrix;
+    };
+
+    // NOTE: array sizes should match Photographer::layered_max_cameras_
+    layout(std140) uniform LayeredCameras
+    {
+        mat4 views[16];
+        mat4 projections[16];
+        vec4 eye_positions[16];
+    };
+
+    void main()
+    {
+        // info for fragment shader
+        vec3 vs_frag_position = vec3(model * vec4(a_pos, 1.0));
+
+        // final coordinates
+        gl_Position = projections[gl_InstanceID] * views[gl_InstanceID] * vec4(vs_frag_position, 1.0);
+        gl_Layer = gl_InstanceID;
+    }
+);
\ No newline at end of file
@@ -6,19 +6,22 @@
 
 static const char *flat_vertex_shader_source = SHADER_CODE_GLSL_TO_STRING(330,
     layout(location = 0) in vec3 a_pos;
-    layout(location = 1) in vec3 a_color;
 
-    flat out vec3 vs_color; //flat/smooth/noperspective
-
-    uniform mat4 model;
-    uniform mat4 normal_matrix;
-    uniform mat4 view;
-    uniform mat4 projection;
+    // blocks are shared by all the programs, see Shader::UniformBlockBindings
+    layout(std140) uniform Transform
+    {
+        mat4 model;
+        mat4 normal_matrix;
+    };
+    layout(std140) uniform Camera
+    {
+        mat4 view;
+        mat4 projection;
+        vec4 eye_pos;
+    };
 
     void main()
     {
-        vs_color = a_color;
-
         // info for fragment shader
         vec3 vs_frag_position = vec3(model * vec4(a_pos, 1.0));
 
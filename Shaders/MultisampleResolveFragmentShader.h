@@ -0,0 +1,23 @@
+#pragma once
+// Resolve of the non-color outputs of the multisampled framebuffer: depth and face index are taken from the same
+// single sample (no averaging), so they stay exact and agree with each other
+
+#ifndef SHADER_CODE_GLSL_TO_STRING
+#define SHADER_CODE_GLSL_TO_STRING(version, shader)  "#version " #version " core \n" #shader  
+#endif
+
+static const char *multisample_resolve_fragment_shader_source = SHADER_CODE_GLSL_TO_STRING(330,
+    // color is resolved by the blit, its writes are masked out
+    layout(location = 1) out uint frag_face_idx;
+
+    uniform sampler2DMS depth_samples;
+    uniform usampler2DMS face_idx_samples;
+    uniform int sample_index;   // the one closest to the pixel center
+
+    void main()
+    {
+        ivec2 pixel = ivec2(gl_FragCoord.xy);
+        gl_FragDepth = texelFetch(depth_samples, pixel, sample_index).r;
+        frag_face_idx = texelFetch(face_idx_samples, pixel, sample_index).r;
+    }
+);
@@ -0,0 +1,15 @@
+#pragma once
+// Full-screen triangle for the per-pixel passes: no vertex data, the corners come from gl_VertexID
+
+#ifndef SHADER_CODE_GLSL_TO_STRING
+#define SHADER_CODE_GLSL_TO_STRING(version, shader)  "#version " #version " core \n" #shader  
+#endif
+
+static const char *multisample_resolve_vertex_shader_source = SHADER_CODE_GLSL_TO_STRING(330,
+    void main()
+    {
+        // (-1, -1), (3, -1), (-1, 3) -- counter-clockwise, covers the viewport
+        vec2 corner = vec2(float((gl_VertexID & 1) << 2) - 1.0, float((gl_VertexID & 2) << 1) - 1.0);
+        gl_Position = vec4(corner, 0.0, 1.0);
+    }
+);
@@ -47,19 +47,27 @@ static const char *no_texture_fragment_shader_source = SHADER_CODE_GLSL_TO_STRIN
     };
 
     // output color!
-    out vec4 frag_color;
+    layout(location = 0) out vec4 frag_color;
+    // index of the face in the draw call; written if the framebuffer has an integer attachment for it
+    layout(location = 1) out uint frag_face_idx;
 
     // From Vertex shader
     in vec3 vs_normal;
     in vec3 vs_frag_position;  // in world coordinates
+    flat in vec3 vs_eye_pos;
 
-    // Uniform properties
-    uniform Material material;
-    uniform vec3 eye_pos;
+    // Uniform properties. Blocks are shared by all the programs, see Shader::UniformBlockBindings
+    layout(std140) uniform MaterialBlock
+    {
+        Material material;
+    };
 
-    uniform DirectionalLight directional_light;
     const int NR_POINT_LIGHTS = 2;
-    uniform PointLight point_lights[NR_POINT_LIGHTS];
+    layout(std140) uniform Lights
+    {
+        DirectionalLight directional_light;
+        PointLight point_lights[NR_POINT_LIGHTS];
+    };
 
     // calculators
     vec3 CalcAmbient    (vec3 light_ambient);
@@ -73,7 +81,7 @@ static const char *no_texture_fragment_shader_source = SHADER_CODE_GLSL_TO_STRIN
     void main()
     {
         vec3 norm = normalize(vs_normal);
-        vec3 view_dir = normalize(eye_pos - vs_frag_position);
+        vec3 view_dir = normalize(vs_eye_pos - vs_frag_position);
     
         vec3 out_color = vec3(0.0);
 
@@ -85,6 +93,7 @@ static const char *no_texture_fragment_shader_source = SHADER_CODE_GLSL_TO_STRIN
         }
 
         frag_color = vec4(out_color, 1.0);
+        frag_face_idx = uint(gl_PrimitiveID);
     }
 
     // -------------- implemetations ---------------
@@ -10,17 +10,28 @@ static const char *no_texture_vertex_shader_source = SHADER_CODE_GLSL_TO_STRING(
 
     out vec3 vs_normal;
     out vec3 vs_frag_position;  // in world coordinates
+    flat out vec3 vs_eye_pos;   // per-camera in the layered rendering
 
-    uniform mat4 model;
-    uniform mat4 normal_matrix;
-    uniform mat4 view;
-    uniform mat4 projection;
+    // blocks are shared by all the programs, see Shader::UniformBlockBindings
+    layout(std140) uniform Transform
+    {
+        mat4 model;
+        mat4 normal_matrix;
+    };
+    layout(std140) uniform Camera
+    {
+        mat4 view;
+        mat4 projection;
+        vec4 eye_pos;
+    };
 
     void main()
     {
         // info for fragment shader
         vs_frag_position = vec3(model * vec4(a_pos, 1.0));
 
+        vs_eye_pos = eye_pos.xyz;
+
         // avoid scaling issues. Equivalent to vector transformation
         vs_normal = mat3(normal_matrix) * a_normal;
 
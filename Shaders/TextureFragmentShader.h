@@ -47,21 +47,30 @@ static const char *texture_fragment_shader_source = SHADER_CODE_GLSL_TO_STRING(3
     };
 
     // output color!
-    out vec4 frag_color;
+    layout(location = 0) out vec4 frag_color;
+    // index of the face in the draw call; written if the framebuffer has an integer attachment for it
+    layout(location = 1) out uint frag_face_idx;
 
     // From Vertex shader
     in vec3 vs_normal;
     in vec2 vs_uv;
     in vec3 vs_frag_position;  // in world coordinates
+    flat in vec3 vs_eye_pos;
 
-    // Uniform properties
-    uniform Material material;
-    uniform vec3 eye_pos;
+    // Uniform properties. Blocks are shared by all the programs, see Shader::UniformBlockBindings
     uniform sampler2D Tex1;
 
-    uniform DirectionalLight directional_light;
+    layout(std140) uniform MaterialBlock
+    {
+        Material material;
+    };
+
     const int NR_POINT_LIGHTS = 2;
-    uniform PointLight point_lights[NR_POINT_LIGHTS];
+    layout(std140) uniform Lights
+    {
+        DirectionalLight directional_light;
+        PointLight point_lights[NR_POINT_LIGHTS];
+    };
 
     // calculators
     vec3 CalcAmbient    (vec3 light_ambient);
@@ -75,7 +84,7 @@ static const char *texture_fragment_shader_source = SHADER_CODE_GLSL_TO_STRING(3
     void main()
     {
         vec3 norm = normalize(vs_normal);
-        vec3 view_dir = normalize(eye_pos - vs_frag_position);
+        vec3 view_dir = normalize(vs_eye_pos - vs_frag_position);
     
         vec3 out_color = vec3(0.0);
 
@@ -89,6 +98,7 @@ static const char *texture_fragment_shader_source = SHADER_CODE_GLSL_TO_STRING(3
         //frag_color = vec4(out_color, 1.0);
         vec2 refine_vs_uv = vec2(vs_uv.x, 1.0 - vs_uv.y);
         frag_color = texture(Tex1, refine_vs_uv) * vec4(out_color, 1.0);
+        frag_face_idx = uint(gl_PrimitiveID);
     }
 
     // -------------- implemetations ---------------
@@ -0,0 +1,60 @@
+#pragma once
+// Renders the same geometry for several cameras at once: one instance == one camera == one layer of the texture array
+
+#ifndef SHADER_CODE_GLSL_TO_STRING_LAYERED
+#define SHADER_CODE_GLSL_TO_STRING_LAYERED(version, shader)  "#version " #version " core \n#extension GL_ARB_shader_viewport_layer_array : require \n" #shader  
+#endif
+
+static const char *texture_layered_vertex_shader_source = SHADER_CODE_GLSL_TO_STRING_LAYERED(330,
+    layout(location = 2) in vec2 a_uv;  // per corner of every face
+
+    // positions and normals are pulled from the shared indexed vertices
+    uniform samplerBuffer vertices;     // GeneralMesh::GLMVertex: position, normal -- 6 floats each
+    uniform usamplerBuffer faces;       // vertex indices of the face corners
+
+    out vec3 vs_normal;
+    out vec2 vs_uv;
+    out vec3 vs_frag_position;  // in world coordinates
+    flat out vec3 vs_eye_pos;
+
+    // blocks are shared by all the programs, see Shader::UniformBlockBindings
+    layout(std140) uniform Transform
+    {
+        mat4 model;
+        mat4 normal_matrix;
+    };
+
+    // NOTE: array sizes should match Photographer::layered_max_cameras_
+    layout(std140) uniform LayeredCameras
+    {
+        mat4 views[16];
+        mat4 projections[16];
+        vec4 eye_positions[16];
+    };
+
+    vec3 fetchVec3(int offset)
+    {
+        return vec3(texelFetch(vertices, offset).r, texelFetch(vertices, offset + 1).r, texelFetch(vertices, offset + 2).r);
+    }
+
+    void main()
+    {
+        int vertex_offset = 6 * int(texelFetch(faces, gl_VertexID).r);
+        vec3 a_pos = fetchVec3(vertex_offset);
+        vec3 a_normal = fetchVec3(vertex_offset + 3);
+
+        // info for fragment shader
+        vs_frag_position = vec3(model * vec4(a_pos, 1.0));
+
+        vs_eye_pos = eye_positions[gl_InstanceID].xyz;
+
+        // avoid scaling issues. Equivalent to vector transformation
+        vs_normal = mat3(normal_matrix) * a_normal;
+
+        vs_uv = a_uv;
+
+        // final coordinates
+        gl_Position = projections[gl_InstanceID] * views[gl_InstanceID] * vec4(vs_frag_position, 1.0);
+        gl_Layer = gl_InstanceID;
+    }
+);
\ No newline at end of file
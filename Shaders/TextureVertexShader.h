@@ -5,24 +5,46 @@
 #endif
 
 static const char *texture_vertex_shader_source = SHADER_CODE_GLSL_TO_STRING(330,
-    layout(location = 0) in vec3 a_pos;
-    layout(location = 1) in vec3 a_normal;
-    layout(location = 2) in vec2 a_uv;
+    layout(location = 2) in vec2 a_uv;  // per corner of every face
+
+    // positions and normals are pulled from the shared indexed vertices
+    uniform samplerBuffer vertices;     // GeneralMesh::GLMVertex: position, normal -- 6 floats each
+    uniform usamplerBuffer faces;       // vertex indices of the face corners
 
     out vec3 vs_normal;
     out vec2 vs_uv;
     out vec3 vs_frag_position;  // in world coordinates
+    flat out vec3 vs_eye_pos;   // per-camera in the layered rendering
+
+    // blocks are shared by all the programs, see Shader::UniformBlockBindings
+    layout(std140) uniform Transform
+    {
+        mat4 model;
+        mat4 normal_matrix;
+    };
+    layout(std140) uniform Camera
+    {
+        mat4 view;
+        mat4 projection;
+        vec4 eye_pos;
+    };
 
-    uniform mat4 model;
-    uniform mat4 normal_matrix;
-    uniform mat4 view;
-    uniform mat4 projection;
+    vec3 fetchVec3(int offset)
+    {
+        return vec3(texelFetch(vertices, offset).r, texelFetch(vertices, offset + 1).r, texelFetch(vertices, offset + 2).r);
+    }
 
     void main()
     {
+        int vertex_offset = 6 * int(texelFetch(faces, gl_VertexID).r);
+        vec3 a_pos = fetchVec3(vertex_offset);
+        vec3 a_normal = fetchVec3(vertex_offset + 3);
+
         // info for fragment shader
         vs_frag_position = vec3(model * vec4(a_pos, 1.0));
 
+        vs_eye_pos = eye_pos.xyz;
+
         // avoid scaling issues. Equivalent to vector transformation
         vs_normal = mat3(normal_matrix) * a_normal;
 
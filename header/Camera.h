@@ -4,6 +4,7 @@
 // It also holds the projection matrix
 // Move rotations to something better
 
+#include <atomic>
 #include <fstream>
 #include <iostream>
 #include <string>
@@ -34,17 +35,32 @@ public:
     Camera(int screen_width, int screen_height, float field_of_view = default_fov_);
     ~Camera();
 
-    unsigned int getID() { return ID_; }
-    glm::vec3 getPosition() { return position_; }
-    glm::vec3 getFrontVector() { return front_; }
+    unsigned int getID() const { return ID_; }
+    glm::vec3 getPosition() const { return position_; }
+    glm::vec3 getFrontVector() const { return front_; }
 
-    glm::mat4 getGlViewMatrix();
-    glm::mat4 getCVExtrinsicsMatrix();
-    glm::mat4 getGlProjectionMatrix();
-    glm::mat3 getCVIntrinsicsMatrix();
-    glm::vec4 getGlViewPortVector();
+    // derived matrices are cached: rebuilt only after the pose or the intrinsics change
+    const glm::mat4& getGlViewMatrix() const;
+    // inverse of the view matrix
+    const glm::mat4& getGlCameraToWorldMatrix() const;
+    const glm::mat4& getCVExtrinsicsMatrix() const;
+    const glm::mat4& getGlProjectionMatrix() const;
+    const glm::mat3& getCVIntrinsicsMatrix() const;
+    glm::vec4 getGlViewPortVector() const;
+
+    // matrices of n cameras into contiguous arrays, ready for the upload to the GPU
+    // (e.g. glBufferSubData of a uniform block). Any output can be nullptr to skip it
+    static void getRigMatrices(const Camera* cameras, std::size_t n, 
+        glm::mat4* views, glm::mat4* projections, glm::vec4* eye_positions = nullptr);
 
     float getFovy() const;
+    // image size in pixels
+    int getWidth() const { return (int)screen_width_; }
+    int getHeight() const { return (int)screen_height_; }
+    // pixels from the top-left corner of the image, OpenCV convention
+    glm::vec2 getPrincipalPoint() const { return principal_point_; }
+    float getNearPlane() const { return near_plane_; }
+    float getFarPlane() const { return far_plane_; }
 
     // allows to set pre-defined id
     void setID(unsigned int id) { ID_ = id; };
@@ -52,16 +68,27 @@ public:
     void setPosition(glm::vec3 pos);
     void setRotation(float pitch, float yaw);
     void setTarget(glm::vec3 target);
+    // position & target at once, quietly switching to target mode: for the cameras set up in bulk
+    void setPose(glm::vec3 pos, glm::vec3 target);
+    // the principal point is moved back to the image center
+    void setResolution(int screen_width, int screen_height);
+    // off-center principal point shifts the GL projection accordingly
+    void setPrincipalPoint(float cx, float cy);
+    // distances to the clipping planes of the GL projection
+    void setClippingPlanes(float near_plane, float far_plane);
 
     void movePosition(Directions direction, float step_size_multiplier = 1.0f);
     void updateRotation(float delta_pitch, float delta_yaw, bool constrain_pitch = true);
     void zoom(float delta);
 
-    void saveParamsForOpenCV(const std::string path = "./", const std::string prefix = "param_");
+    void saveParamsForOpenCV(const std::string path = "./", const std::string prefix = "param_") const;
 
 private:
-    static unsigned int avalible_camera_id;
+    // cameras are created by Photographers on different threads
+    static std::atomic<unsigned int> avalible_camera_id;
     static constexpr float default_fov_ = 35.0f;
+    static constexpr float default_near_plane_ = 0.1f;
+    static constexpr float default_far_plane_ = 100.0f;
     // manipulation
     static constexpr float rotation_sensitivity_ = 0.05f;
     static constexpr float zoom_sensitivity_ = 0.1f;
@@ -72,6 +99,11 @@ private:
     void updateVectorsByRotation_();
     // based on the target
     void updateFrontByTarget_();
+    // caches are rebuilt on the next request
+    void invalidatePose_() { pose_dirty_ = true; }
+    void invalidateIntrinsics_() { intrinsics_dirty_ = true; }
+    void updatePoseMatrices_() const;
+    void updateIntrinsicsMatrices_() const;
 
     // ID
     unsigned int ID_;
@@ -84,15 +116,27 @@ private:
     glm::vec3 front_;
     glm::vec3 up_;
     glm::vec3 right_;
-    const glm::vec3 world_up_ = glm::vec3(0.0f, 1.0f, 0.0f);
+    static const glm::vec3 world_up_;
     // extra -- rotation parameters
     float yaw_, pitch_;
     glm::vec3 target_;
 
     // intrinsic 
     float field_of_view_y_;
+    float near_plane_ = default_near_plane_;
+    float far_plane_ = default_far_plane_;
     float screen_width_;
     float screen_height_;
+    glm::vec2 principal_point_;
+
+    // cache of the derived matrices
+    mutable bool pose_dirty_ = true;
+    mutable bool intrinsics_dirty_ = true;
+    mutable glm::mat4 view_matrix_;
+    mutable glm::mat4 camera_to_world_matrix_;
+    mutable glm::mat4 extrinsics_matrix_;
+    mutable glm::mat4 projection_matrix_;
+    mutable glm::mat3 intrinsics_matrix_;
 
 };
 
@@ -0,0 +1,29 @@
+#pragma once
+// Writes the parameters of many cameras at once into a single file.
+//
+// The text formats can be read with cv::FileStorage: the root node "cameras" is a sequence of maps
+// with id, image_width, image_height and the CameraMatrix (3x4 extrinsics), Intrinsics (3x3) and Distortion (8x1)
+// matrices -- same nodes as the per-camera files of Camera::saveParamsForOpenCV().
+// The binary "PCAM" file is the header of little-endian uint32 -- "PCAM", version (1), number of cameras --
+// followed by the ArchiveCamera records (see FrameArchive.h), the same ones frame archives carry.
+// Files are composed in memory and written with a single call. All functions return non-zero on success
+
+#include <string>
+#include <vector>
+
+#include "Camera.h"
+#include "FrameArchive.h"
+
+class CameraParamsWriter
+{
+public:
+    static int writeOpenCVXML(const std::string& filename, const std::vector<Camera>& cameras);
+    static int writeOpenCVYAML(const std::string& filename, const std::vector<Camera>& cameras);
+    static int writeBinary(const std::string& filename, const std::vector<Camera>& cameras);
+
+    // OpenCV conventions, matrices are row-major
+    static ArchiveCamera record(const Camera& camera);
+
+private:
+    static int writeFile_(const std::string& filename, const std::string& content);
+};
@@ -0,0 +1,83 @@
+#pragma once
+// Image cameras of the Photographer.
+//
+// Cameras are kept in a dense array in the render order, so the loops over the rig and the batch queries
+// (Camera::getRigMatrices()) run over contiguous memory. Handles stay valid until their camera is removed:
+// a handle points to a slot, and the slot -- to the current place of the camera in the dense array.
+// Removal is O(1): the last camera takes the place of the removed one.
+// Positions, view directions, intrinsics and image sizes are mirrored into parallel arrays (structure-of-arrays)
+// for the whole-rig queries. The rig keeps them in sync, hence the cameras are changed through the rig only.
+// Full orientations (up vectors) are not mirrored: the matrix uploads read the cached matrices of the cameras
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Camera.h"
+
+class CameraRig
+{
+public:
+    struct Handle
+    {
+        std::uint32_t slot = 0;
+        std::uint32_t generation = 0;   // 0 -- null handle, never valid
+
+        bool operator==(const Handle& other) const { return slot == other.slot && generation == other.generation; }
+        bool operator!=(const Handle& other) const { return !(*this == other); }
+    };
+
+    CameraRig() {};
+
+    Handle add(const Camera& camera);
+    // false if the handle is null or its camera is already removed
+    bool remove(Handle handle);
+    void clear();
+    void reserve(std::size_t n_cameras);
+
+    bool contains(Handle handle) const;
+    // place in the dense array, or size() if the handle is not valid
+    std::size_t indexOf(Handle handle) const;
+    Handle handleAt(std::size_t index) const;
+    // nullptr if the handle is not valid
+    const Camera* find(Handle handle) const;
+
+    std::size_t size() const { return cameras_.size(); }
+    bool empty() const { return cameras_.empty(); }
+    const Camera& operator[](std::size_t index) const { return cameras_[index]; }
+    std::vector<Camera>::const_iterator begin() const { return cameras_.begin(); }
+    std::vector<Camera>::const_iterator end() const { return cameras_.end(); }
+    const std::vector<Camera>& cameras() const { return cameras_; }
+
+    // edits by the place in the dense array
+    void setPose(std::size_t index, glm::vec3 position, glm::vec3 target);
+    void setResolution(std::size_t index, int width, int height);
+    void setPrincipalPoint(std::size_t index, float cx, float cy);
+    void setClippingPlanes(std::size_t index, float near_plane, float far_plane);
+
+    // structure-of-arrays mirrors, in the order of the dense array
+    const std::vector<glm::vec3>& positions() const { return positions_; }
+    // unit front vectors
+    const std::vector<glm::vec3>& viewDirections() const { return view_directions_; }
+    // fx, fy, cx, cy in pixels, OpenCV convention
+    const std::vector<glm::vec4>& intrinsics() const { return intrinsics_; }
+    const std::vector<glm::ivec2>& imageSizes() const { return image_sizes_; }
+
+private:
+    // copies the state of the camera into the mirrors
+    void mirror_(std::size_t index);
+
+    // dense, in the render order
+    std::vector<Camera> cameras_;
+    std::vector<std::uint32_t> slots_;   // slot of every camera
+    std::vector<glm::vec3> positions_;
+    std::vector<glm::vec3> view_directions_;
+    std::vector<glm::vec4> intrinsics_;
+    std::vector<glm::ivec2> image_sizes_;
+
+    // by slot
+    std::vector<std::uint32_t> slot_indices_;   // place of the camera in the dense array
+    std::vector<std::uint32_t> slot_generations_;   // odd -- in use, bumped on every add & remove
+    std::vector<std::uint32_t> free_slots_;
+};
@@ -0,0 +1,114 @@
+#pragma once
+// Creates the OpenGL context Photographer renders with.
+//
+// GLFW is the only backend that can show a window -- it's always used by viewScene().
+// EGL (surfaceless) and OSMesa backends don't need a display server at all:
+// they only make the context current, rendering goes to the custom framebuffer.
+//
+// Headless backends are optional dependencies, enable them with the preprocessor flags
+// PHOTOGRAPHER_WITH_EGL (link libEGL) and PHOTOGRAPHER_WITH_OSMESA (link libOSMesa)
+//
+// Every Photographer owns its context, so several of them can render on different threads at once.
+// Process-wide state is shared with reference counting: GLFW library, EGL display, glad function pointers.
+// Hence all the contexts alive at the same time should come from one backend.
+// GLFW expects its windows to be created and destroyed on the main thread -- use EGL or OSMesa for the worker threads
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+// #define PHOTOGRAPHER_WITH_EGL    // uncomment to enable EGL backend
+// #define PHOTOGRAPHER_WITH_OSMESA // uncomment to enable OSMesa backend
+
+#ifdef PHOTOGRAPHER_WITH_EGL
+#include <EGL/egl.h>
+#endif
+
+class ContextBackend
+{
+public:
+    enum BackendTypes
+    {
+        GLFW_BACKEND,   // hidden window when not visible. Needs a display (or Xvfb)
+        EGL_BACKEND,    // surfaceless EGL
+        OSMESA_BACKEND  // Mesa off-screen software rendering
+    };
+
+    virtual ~ContextBackend();
+
+    // creates the context and makes it current
+    virtual bool init(int width, int height, bool visible) = 0;
+    virtual void terminate() = 0;
+    // binds the context to the calling thread: another Photographer might have taken it,
+    // or the session goes on on another thread
+    virtual bool makeCurrent() = 0;
+    virtual GLADloadproc getProcLoader() = 0;
+    // glad for the current context. Functions are loaded by the first context of the process
+    // and stay while any context uses them. Fails if the contexts alive come from another backend
+    bool loadGL();
+    // nullptr for the headless backends
+    virtual GLFWwindow* getWindow() { return nullptr; }
+
+    // nullptr if the backend is not compiled in
+    static ContextBackend* create(BackendTypes type);
+    static bool isAvailable(BackendTypes type);
+    // allows to choose the backend without recompilation:
+    // PHOTOGRAPHER_CONTEXT=glfw|egl|osmesa
+    static BackendTypes typeFromEnvironment(BackendTypes fallback);
+
+private:
+    bool gl_loaded_ = false;
+};
+
+class GLFWContextBackend : public ContextBackend
+{
+public:
+    bool init(int width, int height, bool visible) override;
+    void terminate() override;
+    bool makeCurrent() override;
+    GLADloadproc getProcLoader() override;
+    GLFWwindow* getWindow() override { return window_; }
+
+private:
+    GLFWwindow* window_ = nullptr;
+};
+
+#ifdef PHOTOGRAPHER_WITH_EGL
+class EGLContextBackend : public ContextBackend
+{
+public:
+    bool init(int width, int height, bool visible) override;
+    void terminate() override;
+    bool makeCurrent() override;
+    GLADloadproc getProcLoader() override;
+
+private:
+    EGLDisplay display_ = EGL_NO_DISPLAY;
+    EGLContext context_ = EGL_NO_CONTEXT;
+};
+#endif
+
+#ifdef PHOTOGRAPHER_WITH_OSMESA
+struct osmesa_context;
+
+class OSMesaContextBackend : public ContextBackend
+{
+public:
+    bool init(int width, int height, bool visible) override;
+    void terminate() override;
+    bool makeCurrent() override;
+    GLADloadproc getProcLoader() override;
+
+private:
+    static void* getProcAddress_(const char* name);
+
+    osmesa_context* context_ = nullptr;
+    // OSMesa needs a default color buffer to make the context current
+    std::vector<unsigned char> default_buffer_;
+    int width_ = 0;
+    int height_ = 0;
+};
+#endif
@@ -0,0 +1,59 @@
+#pragma once
+// Pose files of the multi-view reconstruction datasets, written as the frames are saved.
+//
+// NeRF: <path>/transforms.json with a record per frame -- file_path, camera-to-world transform_matrix
+//       (OpenGL axes, as NeRF loaders expect), per-frame camera_model (OPENCV) and intrinsics fl_x, fl_y, cx, cy, w, h, and
+//       depth_file_path & mask_path when present (nerfstudio names).
+// COLMAP: text model in <path>/sparse/0: cameras.txt (a PINHOLE camera per view), images.txt
+//       (world-to-camera quaternion & translation, OpenCV axes; the points line is left empty) and an empty points3D.txt.
+// Image ids of COLMAP are the camera ids, image names are relative to <path>/images.
+//
+// Every record is flushed as soon as it's added and transforms.json is closed after each record,
+// so the files of an interrupted run describe all the frames saved so far.
+// Records follow the order the frames are saved in, which is not always the camera order
+
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+#include "FrameArchive.h"
+
+class DatasetWriter
+{
+public:
+    enum Formats
+    {
+        NERF = 1,
+        COLMAP = 2,
+        NERF_AND_COLMAP = NERF | COLMAP
+    };
+
+    struct View
+    {
+        ArchiveCamera params;       // OpenCV intrinsics & extrinsics, see CameraParamsWriter::record()
+        float transform[16];        // camera-to-world in OpenGL axes, row-major
+        std::string image_name;     // relative to the dataset root
+        std::string depth_name;     // empty if there is no depth
+        std::string mask_name;      // empty if there is no mask
+    };
+
+    DatasetWriter() {};
+    ~DatasetWriter();
+
+    // path should exist
+    bool open(const std::string& path, Formats formats);
+    // thread-safe: called by the encoder threads
+    int addView(const View& view);
+    void close();
+
+private:
+    bool appendNeRF_(const View& view);
+    bool appendCOLMAP_(const View& view);
+
+    std::FILE* transforms_ = nullptr;
+    long transforms_end_ = 0;   // the closing brackets start here
+    std::size_t n_transforms_ = 0;
+    std::FILE* colmap_cameras_ = nullptr;
+    std::FILE* colmap_images_ = nullptr;
+    std::mutex mutex_;
+};
@@ -0,0 +1,49 @@
+#pragma once
+// Result of Photographer::computeFaceVisibility(): which faces of the target object are seen by a camera
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct FaceVisibility
+{
+    unsigned int camera_id = 0;
+    std::size_t n_faces = 0;
+    // bit (face % 32) of words[face / 32] is set if the face covers at least one pixel of the camera image
+    std::vector<std::uint32_t> words;
+
+    bool isVisible(std::size_t face) const
+    {
+        return face < n_faces && (words[face / 32] >> (face % 32)) & 1u;
+    }
+
+    // indices of the visible faces in increasing order
+    std::vector<unsigned int> visibleFaces() const
+    {
+        std::vector<unsigned int> faces;
+        for (std::size_t word = 0; word < words.size(); ++word)
+        {
+            for (unsigned int bit = 0; bit < 32 && words[word] != 0; ++bit)
+            {
+                if ((words[word] >> bit) & 1u)
+                {
+                    faces.push_back((unsigned int)(word * 32 + bit));
+                }
+            }
+        }
+        return faces;
+    }
+
+    std::size_t countVisible() const
+    {
+        std::size_t count = 0;
+        for (std::uint32_t bits : words)
+        {
+            for (; bits != 0; bits &= bits - 1)
+            {
+                ++count;
+            }
+        }
+        return count;
+    }
+};
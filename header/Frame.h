@@ -0,0 +1,47 @@
+#pragma once
+// In-memory rendering results of Photographer::renderToFrames() and Photographer::renderToCallback()
+//
+// Pixels are stored the GL way: the first row in memory is the bottom row of the image.
+// Color is 8-bit RGB for all the current shaders, depth is a single float channel, face indices -- a single uint32 one
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Non-owning: the pixels belong to somebody else (a Frame or the renderer)
+struct ImageView
+{
+    const unsigned char* data = nullptr;   // bottom row first
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    int bytes_per_channel = 1;  // 4 for float
+    int stride = 0;     // bytes between the starts of the consecutive rows, >= width * channels * bytes_per_channel
+    unsigned int camera_id = 0;
+
+    // y is counted from the bottom, like in GL
+    const unsigned char* row(int y) const { return data + (std::ptrdiff_t)y * stride; }
+    // y is counted from the top, like in the image files
+    const unsigned char* topDownRow(int y) const { return row(height - 1 - y); }
+};
+
+// Owns its pixels: the storage lives while any frame refers to it.
+// Frames of the same atlas share one buffer -- the view points into the middle of it
+struct Frame
+{
+    // face index of the pixels not covered by the object
+    static constexpr unsigned int background_face_idx = 0xFFFFFFFFu;
+
+    ImageView view;
+    std::shared_ptr<const std::vector<unsigned char>> pixels;
+
+    // metric depth along the view axis (object units, 0 for the background) if Photographer::setDepthExport() is on.
+    // depth.data is nullptr otherwise
+    ImageView depth;
+    std::shared_ptr<const std::vector<unsigned char>> depth_pixels;
+
+    // index of the visible face of the target object (the order of GeneralMesh::getFaces()) for every pixel
+    // if Photographer::setFaceIndexExport() is on. face_idx.data is nullptr otherwise
+    ImageView face_idx;
+    std::shared_ptr<const std::vector<unsigned char>> face_idx_pixels;
+};
@@ -0,0 +1,116 @@
+#pragma once
+// Single-file archive of the rendered frames: one file per run instead of a file per view.
+//
+// Layout, all little-endian:
+//   header (64 bytes): "PFAR", version (1) -- uint32; index offset, number of entries,
+//                      camera block offset, number of cameras -- uint64; zeros up to 64 bytes
+//   payloads:          pixels of every entry, each starting at a 64-byte boundary
+//   camera block:      ArchiveCamera records
+//   index:             ArchiveEntry records
+// Payloads are the raw pixel values without padding, bottom row first -- exactly the layout of the ImageView
+// the frame came with, so the mapped file is read without copies (numpy readers flip the rows with [::-1]).
+//
+// The writer streams: payloads go to the file as they come, only the index and the cameras are kept in memory.
+// The header is completed by finish(), so an archive of an interrupted run has a zero index offset
+
+#include <cstddef>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Frame.h"
+
+// index record
+struct ArchiveEntry
+{
+    enum Kinds
+    {
+        COLOR = 0,      // uint8 RGB
+        DEPTH = 1,      // float32 metric depth
+        FACE_IDX = 2    // uint32 face indices
+    };
+
+    unsigned int camera_id;
+    unsigned int kind;
+    unsigned int width;
+    unsigned int height;
+    unsigned int channels;
+    unsigned int bytes_per_channel;
+    unsigned long long offset;   // from the start of the file
+    unsigned long long size;     // bytes
+};
+
+// parameters of the camera in OpenCV conventions, as in Camera::saveParamsForOpenCV()
+struct ArchiveCamera
+{
+    unsigned int camera_id;
+    unsigned int width;
+    unsigned int height;
+    unsigned int reserved;
+    float intrinsics[9];    // 3x3, row-major
+    float extrinsics[12];   // 3x4 [R|t], row-major
+};
+
+class FrameArchiveWriter
+{
+public:
+    FrameArchiveWriter() {};
+    ~FrameArchiveWriter();
+
+    bool open(const std::string& filename);
+    // the color and (if present) the depth & face indices of the frame. Thread-safe: called by the encoder threads.
+    // Returns non-zero on success, like the image writers
+    int addFrame(const Frame& frame);
+    void addCamera(const ArchiveCamera& camera);
+    // writes the cameras & the index and completes the header. Returns false if anything has failed to be written
+    bool finish();
+
+    static constexpr std::size_t header_size = 64;
+    static constexpr std::size_t alignment = 64;
+
+private:
+    bool addImage_(const ImageView& view, unsigned int kind);
+    // with the mutex locked
+    bool writeAligned_(const void* data, std::size_t size);
+
+    std::FILE* file_ = nullptr;
+    std::string filename_;
+    unsigned long long position_ = 0;
+    bool failed_ = false;
+    std::vector<ArchiveEntry> entries_;
+    std::vector<ArchiveCamera> cameras_;
+    std::mutex mutex_;
+};
+
+// Memory-maps the archive: the views point right into the mapping and live as long as the reader
+class FrameArchiveReader
+{
+public:
+    FrameArchiveReader() {};
+    ~FrameArchiveReader();
+
+    bool open(const std::string& filename);
+    void close();
+
+    // entries in the order they were written
+    const std::vector<ArchiveEntry>& entries() const { return entries_; }
+    const std::vector<ArchiveCamera>& cameras() const { return cameras_; }
+    // nullptr if there is no such entry
+    const ArchiveEntry* find(unsigned int camera_id, ArchiveEntry::Kinds kind = ArchiveEntry::COLOR) const;
+    // no copies: valid while the archive is open
+    ImageView view(const ArchiveEntry& entry) const;
+
+private:
+    bool map_(const std::string& filename);
+    void unmap_();
+
+    const unsigned char* data_ = nullptr;
+    std::size_t size_ = 0;
+#ifdef _WIN32
+    void* file_handle_ = nullptr;
+    void* mapping_handle_ = nullptr;
+#endif
+    std::vector<ArchiveEntry> entries_;
+    std::vector<ArchiveCamera> cameras_;
+};
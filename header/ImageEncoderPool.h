@@ -0,0 +1,67 @@
+#pragma once
+// Encodes rendered frames on background threads, so the GL thread can keep rendering
+//
+// Tasks are queued in the order of submission and their results are reported in the same order.
+// The queue is bounded: submit() blocks only when it's full.
+// Pixel buffers are recycled: a buffer from acquireBuffer() returns to the pool
+// once the last task holding it is done
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+class ImageEncoderPool
+{
+public:
+    // returns non-zero on success
+    typedef std::function<int()> EncodeTask;
+    typedef std::shared_ptr<std::vector<unsigned char>> PixelBuffer;
+
+    ImageEncoderPool(std::size_t n_threads, std::size_t queue_capacity);
+    ~ImageEncoderPool();
+
+    // a buffer of at least the requested size, reused when possible
+    PixelBuffer acquireBuffer(std::size_t size);
+
+    // returns the ticket of the task == its position in the results of finish()
+    std::size_t submit(EncodeTask task);
+    // waits for all the submitted tasks; the results follow the submission order
+    std::vector<int> finish();
+
+    static std::size_t defaultThreadsNumber();
+
+private:
+    struct Job
+    {
+        std::size_t ticket;
+        EncodeTask task;
+    };
+
+    // buffers are returned here even if they outlive the pool
+    struct BufferStorage
+    {
+        std::mutex mutex;
+        std::vector<std::vector<unsigned char>*> free_buffers;
+        ~BufferStorage();
+    };
+
+    void workerLoop_();
+
+    std::vector<std::thread> workers_;
+    std::shared_ptr<BufferStorage> buffers_;
+
+    std::size_t queue_capacity_;
+    std::queue<Job> queue_;
+    std::vector<int> results_;
+    std::size_t tasks_in_progress_ = 0;
+    bool stop_ = false;
+
+    std::mutex mutex_;
+    std::condition_variable queue_not_empty_;
+    std::condition_variable queue_not_full_;
+    std::condition_variable all_done_;
+};
@@ -0,0 +1,75 @@
+#pragma once
+// Writers for the image formats stb_image_write doesn't cover: 16-bit & uncompressed PNG, PPM/PGM, QOI, raw data,
+// numpy arrays and face index maps. 8-bit PNG is here as well: stb takes the flip and the compression level
+// from the process-wide settings, these writers take everything as arguments and are safe to call from any thread.
+//
+// Input rows are bottom-up (GL order), files are written top row first -- same as the color images.
+// stride is the number of bytes between the starts of consecutive input rows.
+// All functions return non-zero on success, like stbi_write_*
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+class ImageWriter
+{
+public:
+    // element types of the raw files
+    enum RawTypes
+    {
+        RAW_UINT8 = 0,
+        RAW_UINT32 = 1,
+        RAW_FLOAT32 = 2
+    };
+
+    // 8-bit PNG (1 -- gray, 3 -- RGB, 4 -- RGBA channels), adaptive filtering & stb's zlib at compression_level,
+    // as stbi_write_png() does. Level 0 is the same as writeUncompressedPNG()
+    static int writePNG(const std::string& filename, int width, int height, int channels,
+        const unsigned char* data, int stride, int compression_level = 8);
+    // single-channel 16-bit grayscale PNG. Compressed with stb's zlib at compression_level,
+    // stored uncompressed if the level is 0
+    static int writePNG16(const std::string& filename, int width, int height, const unsigned short* data, int stride,
+        int compression_level = 8);
+    // 8-bit PNG (1 -- gray, 3 -- RGB, 4 -- RGBA channels) without compression or filtering:
+    // just the pixels in stored deflate blocks. For the level 0, where stb's zlib can't go
+    static int writeUncompressedPNG(const std::string& filename, int width, int height, int channels,
+        const unsigned char* data, int stride);
+    // binary PGM (1 channel) or PPM (3 channels), 8 bits per channel
+    static int writePNM(const std::string& filename, int width, int height, int channels, const unsigned char* data, int stride);
+    // binary 16-bit PGM, big-endian as the format requires
+    static int writePGM16(const std::string& filename, int width, int height, const unsigned short* data, int stride);
+    // "Quite OK Image" format (3 or 4 channels): lossless, a few times faster to encode than PNG at a similar size
+    static int writeQOI(const std::string& filename, int width, int height, int channels, const unsigned char* data, int stride);
+    // "PRAW" file: 24-byte header of little-endian uint32 -- "PRAW", version (1), width, height, channels, RawTypes --
+    // followed by the little-endian values of the rows, top row first, without padding
+    static int writeRaw(const std::string& filename, int width, int height, int channels, RawTypes type,
+        const void* data, int stride);
+    // little-endian float32 values without any header
+    static int writeFloatRaw(const std::string& filename, int width, int height, const float* data, int stride);
+    // float32 numpy array of shape (height, width), version 1.0 of the .npy format
+    static int writeFloatNpy(const std::string& filename, int width, int height, const float* data, int stride);
+    // uint32 numpy array of shape (height, width)
+    static int writeUIntNpy(const std::string& filename, int width, int height, const unsigned int* data, int stride);
+    // uint8 numpy array of shape (height, width, channels)
+    static int writeUByteNpy(const std::string& filename, int width, int height, int channels, const unsigned char* data, int stride);
+    // "PFID" face index map: run-length encoded uint32 values, all little-endian.
+    // Header: "PFID", version (1), width, height, number of runs -- uint32 each;
+    // followed by (face index, run length) uint32 pairs that cover the image top row first, left to right.
+    // Runs continue across the rows
+    static int writeFaceIndexMap(const std::string& filename, int width, int height, const unsigned int* data, int stride);
+
+private:
+    // descr is the numpy type string, e.g. '<f4'. channels == 0 leaves the last dimension out
+    static int writeNpy_(const std::string& filename, int width, int height, int channels, const char* descr, int element_size,
+        const void* data, int stride);
+    // PNG file around the filtered scanlines: stb's zlib at compression_level or stored blocks at 0
+    static int writePNG_(const std::string& filename, int width, int height, int bit_depth, int color_type,
+        const std::vector<unsigned char>& scanlines, int compression_level);
+    // header + rows top down
+    static int writeFile_(const std::string& filename, const void* header, std::size_t header_size,
+        int height, const unsigned char* data, int row_size, int stride);
+    static bool writeRowsTopDown_(std::FILE* file, int height, const unsigned char* data, int row_size, int stride);
+    static unsigned int adler32_(const unsigned char* data, std::size_t size);
+    static unsigned int crc32_(const unsigned char* data, std::size_t size, unsigned int crc = 0);
+};
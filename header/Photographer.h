@@ -5,6 +5,9 @@
 // 
 // Note: the set-up of the Buffer objects is tightly coupled with the variable location settings in the shaders loaded by the Shader class
 #include <iostream>
+#include <functional>
+#include <map>
+#include <memory>
 #include <glad/glad.h> 
 #include <GLFW/glfw3.h>
 #include <stb/stb_image.h>
@@ -24,12 +27,61 @@
 // Local
 #include "Shader.h"
 #include "Camera.h"
+#include "CameraRig.h"
+#include "RigGenerator.h"
+#include "ImageEncoderPool.h"
+#include "Frame.h"
+#include "FaceVisibility.h"
+#include "FrameArchive.h"
+#include "CameraParamsWriter.h"
+#include "DatasetWriter.h"
+#include "ImageWriter.h"
+#include "ContextBackend.h"
+#include "ShadingParams.h"
+#include "SoftwareRasterizer.h"
 
 // #define __APPLE__    // uncomment this statement to fix compilation on Mac OS X
 
 class Photographer
 {
+    friend class RenderSession;
 public:
+    enum RenderBackendTypes
+    {
+        GL_RENDER_BACKEND,      // OpenGL through the context backend
+        SOFTWARE_RENDER_BACKEND // built-in CPU rasterizer: no GL or display is needed
+    };
+    // the fastest to write are the uncompressed ones: PNG at the compression level 0, PPM, RAW and NPY
+    enum ImageFormats
+    {
+        IMAGE_PNG,          // 8-bit RGB png at png_compression_level
+        IMAGE_PPM,          // binary PPM
+        IMAGE_QOI,          // "Quite OK Image": lossless, encoded much faster than png
+        IMAGE_RAW,          // uint8 RGB values after a small header, see ImageWriter::writeRaw()
+        IMAGE_NPY           // uint8 numpy array of (height, width, 3)
+    };
+    enum DepthFormats
+    {
+        DEPTH_PNG16,        // 16-bit grayscale png of depth * png_depth_scale
+        DEPTH_FLOAT_RAW,    // float32 values without a header, top row first
+        DEPTH_NPY,          // float32 numpy array of (height, width)
+        DEPTH_PGM16,        // 16-bit binary PGM of depth * png_depth_scale
+        DEPTH_RAW           // float32 values after a small header, see ImageWriter::writeRaw()
+    };
+    enum FaceIndexFormats
+    {
+        FACE_IDX_PFID,      // run-length encoded binary map, see ImageWriter::writeFaceIndexMap()
+        FACE_IDX_NPY,       // uint32 numpy array of (height, width)
+        FACE_IDX_RAW        // uint32 values after a small header, see ImageWriter::writeRaw()
+    };
+    enum CameraParamsFormats
+    {
+        PARAMS_OPENCV_PER_CAMERA,   // <prefix><camera id>.xml for every camera, as OpenPose expects
+        PARAMS_OPENCV_XML,          // all cameras in <prefix>cameras.xml, see CameraParamsWriter
+        PARAMS_OPENCV_YAML,         // all cameras in <prefix>cameras.yml
+        PARAMS_BINARY               // all cameras in <prefix>cameras.pcam
+    };
+
     Photographer();
     Photographer(GeneralMesh* target_object, Shader::ShaderTypes vertex_shader_type = Shader::ShaderTypes::DEFAULT_SHADER, Shader::ShaderTypes fragment_shader_type = Shader::ShaderTypes::DEFAULT_SHADER);
     ~Photographer();
@@ -37,73 +89,318 @@ public:
     void setShader(Shader::ShaderTypes shader_id);
     void setShader(Shader::ShaderTypes v_id, Shader::ShaderTypes f_id);
     void viewScene(bool loop = true);
+    // with the depth export on, the depth map follows its image in the list of the saved files
     std::vector<std::string> renderToImages(const std::string path = "./", const std::string prefix = "view_");
-    void saveImageCamerasParamsCV(const std::string path = "./", const std::string prefix = "param_");
+    // Same rendering as renderToImages(), but no files: frames of all the image cameras in the camera order.
+    // Pixels are copied out of the GL buffers once, into the memory owned by the frames
+    std::vector<Frame> renderToFrames();
+    // the view is borrowed: valid only during the call, as it might point right into the mapped GL buffer.
+    // Called on the rendering thread in the camera order -- don't call GL from it
+    typedef std::function<void(const ImageView&)> FrameCallback;
+    void renderToCallback(FrameCallback on_frame);
+    // All the frames (with depth & face indices if they are on) and the OpenCV parameters of the cameras 
+    // go into a single file instead of a file per view, see FrameArchive.h. The file is written as the frames come
+    // on the encoder threads, so the memory doesn't grow with the number of cameras.
+    // Pixels are stored raw, the image formats don't apply. Returns the number of frames stored
+    int renderToArchive(const std::string filename);
+    // Multi-view reconstruction dataset in one pass: images go to path/images/, depth (if the depth export is on) to
+    // path/depth/, object masks (8-bit png, 255 on the object) to path/masks/; the poses to transforms.json and/or
+    // the COLMAP text model -- see DatasetWriter. The pose of a view is added right after its files are saved,
+    // so an interrupted run leaves a usable dataset. Masks are rendered as the face indices, no face files are saved.
+    // Returns the number of views stored
+    int renderToDataset(const std::string path, DatasetWriter::Formats formats = DatasetWriter::NERF_AND_COLMAP, 
+        bool with_masks = false);
+
+    // Renders all the image cameras for each mesh in a single context; images of the i-th mesh go to path/i/
+    // The next mesh is loaded & prepared on a worker thread while the current one is drawn.
+    // The target object is restored afterwards
+    std::vector<std::vector<std::string>> renderMeshBatch(const std::vector<GeneralMesh*>& meshes, 
+        const std::string path = "./", const std::string prefix = "view_");
+    // factory returns nullptr when there are no more meshes. Meshes are deleted after rendering
+    typedef std::function<std::unique_ptr<GeneralMesh>()> MeshFactory;
+    std::vector<std::vector<std::string>> renderMeshBatch(MeshFactory next_mesh,
+        const std::string path = "./", const std::string prefix = "view_");
+    // the single-file formats are much faster to write and read for large rigs
+    void saveImageCamerasParamsCV(const std::string path = "./", const std::string prefix = "param_", 
+        CameraParamsFormats format = PARAMS_OPENCV_PER_CAMERA);
+
+    // images are encoded in the background while the next cameras are rendered
+    // NOTE: applied on the next session or render call
+    void setEncoderThreads(std::size_t n_threads) { encoder_threads_ = n_threads; }
+    // rendering waits only when that many frames are waiting to be encoded
+    void setEncoderQueueSize(std::size_t queue_size) { encoder_queue_size_ = queue_size; }
+    // context for renderToImages(). viewScene() always uses GLFW window.
+    // Default can be overriden with PHOTOGRAPHER_CONTEXT env variable
+    void setContextBackend(ContextBackend::BackendTypes backend_type) { context_backend_type_ = backend_type; }
+    // affects renderToImages() only
+    void setRenderBackend(RenderBackendTypes backend_type);
+    // renders up to n_cameras (max 16) in a single instanced pass into the layers of a texture array.
+    // 1 (default) draws the cameras one by one -- also used if GL_ARB_shader_viewport_layer_array is missing
+    void setCamerasPerPass(std::size_t n_cameras);
+    // tiles the camera views into a large atlas (at most max_atlas_size^2) that is read back with one transfer.
+    // Pays off for many low-resolution cameras. Takes precedence over setCamerasPerPass()
+    // NOTE: a few silhouette pixels might differ from the per-camera rendering due to the subpixel precision
+    void setAtlasRendering(bool enable, int max_atlas_size = 4096);
+    // file format of the color images of renderToImages(). png_compression_level is the zlib level of stb (8 by default);
+    // 0 stores the pixels without compression -- several times faster to write. The level applies to DEPTH_PNG16 as well
+    void setImageFormat(ImageFormats format, int png_compression_level = 8);
+    // Metric depth (distance along the view axis in the object units, 0 for the background) is rendered in the same pass
+    // as the color and saved next to every image as <prefix><camera id>_depth.<ext>. Frames carry it in Frame::depth.
+    // Cameras are rendered one by one while it's on: no atlas or layered passes.
+    // NOTE: clipping planes of the image cameras are fitted to the object bounds for the render call while the depth is on;
+    // the cameras get their own planes back afterwards
+    void setDepthExport(bool enable, DepthFormats format = DEPTH_NPY, float png_depth_scale = 1000.0f);
+    // Index of the visible face for every pixel (uint32, Frame::background_face_idx where the object is not visible),
+    // rendered into an integer attachment in the same pass as the color with any but the DEFAULT fragment shader
+    // (render calls refuse to run with it while the export is on).
+    // Saved next to every image as <prefix><camera id>_faces.<ext>; frames carry it in Frame::face_idx.
+    // Like the depth, needs the cameras to be rendered one by one
+    void setFaceIndexExport(bool enable, FaceIndexFormats format = FACE_IDX_PFID);
+    // MSAA for the color images: 0 or 1 -- off, otherwise the number of samples (clamped to what the GPU supports).
+    // Depth and face indices are rendered in the same pass, but are taken from a single sample -- never blended.
+    // Like the depth, needs the cameras to be rendered one by one. GL backend only
+    void setMultisampling(int n_samples);
+    // Faces of the target object seen by every image camera (in the camera order); no images are produced.
+    // With the GL backend the face index image of a camera is turned into a bitset on the GPU,
+    // and only the bitsets are read back -- 1 bit per face instead of 4 bytes per pixel.
+    // Works with any but the DEFAULT fragment shader, or with the software backend
+    std::vector<FaceVisibility> computeFaceVisibility();
 
     void setObject(GeneralMesh* object);
     // allows to specify either absolute position
     // or direction + distance to target (if dist is set) 
-    void addCameraToPosition(float x, float y, float z, float dist = -1.0);
+    CameraRig::Handle addCameraToPosition(float x, float y, float z, float dist = -1.0);
     //dist == diameter
     void addCameraRingRoutine(int total_num, float y = 0.0f, float dist = 2.0f);
     void addCameraToPositionShaker(float x, float y, float z, float dist);
     void addCameraToPositionShaker(float x, float x_range, float x_counter, float y, float y_range, float y_counter, float z, float z_range, float z_counter, float dist);
+    // a camera per position, all looking at the target, added in one go (see RigGenerator for the common rigs).
+    // dist works as in addCameraToPosition()
+    void addCameraRig(const std::vector<glm::vec3>& positions, float dist = -1.0f);
+    // image size of the cameras added afterwards (and of the default camera). 1024x1024 unless set
+    void setDefaultImageSize(int width, int height);
+    // intrinsics of the image camera camera_idx (its place in getImageCameras()): image size in pixels 
+    // and principal point -- pixels from the top-left corner (OpenCV convention), the image center unless set.
+    // Cameras of different sizes are rendered in the same call: every size gets its own framebuffer kept for the session.
+    // Atlas and layered passes need all the cameras to be of the same size
+    void setCameraResolution(int camera_idx, int width, int height);
+    void setCameraPrincipalPoint(int camera_idx, float cx, float cy);
 
     Eigen::RowVector3d getDefaultCameraPosition() const;
     Eigen::RowVector3d getDefaultProjectPlaneNormal() const;
+    // view direction of the camera camera_idx (its place in getImageCameras()), the default one if there is no such camera
     Eigen::RowVector3d getCameraProjectPlaneNormal(int camera_idx) const;
+    // unit view directions of all the image cameras, a row per camera in the order of getImageCameras()
+    Eigen::MatrixXd getCameraProjectPlaneNormals() const;
 
-    const std::vector<Camera> getImageCameras();
+    // no copy: valid while the Photographer lives. Cameras are rendered in this order
+    const CameraRig& getImageCameras() const;
+    // the last camera takes the place of the removed one. False if the camera is already removed
+    bool removeCamera(CameraRig::Handle camera);
+    void clearCameras();
 
 private:
+    // per-camera rendering: framebuffer with all the attachments for one image size
+    struct RenderTarget
+    {
+        int width = 0;
+        int height = 0;
+        unsigned int framebuffer = 0;
+        unsigned int color_buffer = 0;
+        unsigned int depth_buffer = 0;      // depth-stencil renderbuffer, detached when depth_texture is there
+        unsigned int depth_texture = 0;     // depth export
+        unsigned int face_idx_buffer = 0;   // face index export: R32UI at COLOR_ATTACHMENT1
+        // multisampling: objects are drawn here and resolved into the framebuffer above
+        int multisample_samples = 0;
+        bool multisample_face_idx = false;
+        int multisample_center_sample = 0;  // depth & face index are taken from it
+        unsigned int multisample_framebuffer = 0;
+        unsigned int multisample_color_buffer = 0;     // renderbuffer
+        unsigned int multisample_depth_buffer = 0;     // textures -- sampled by the resolve
+        unsigned int multisample_face_idx_buffer = 0;
+    };
+    typedef std::pair<int, int> ImageSize;
+
     static constexpr const char* const vertex_shader_path_ = "./Shaders/VertexShader.glsl";
     static constexpr const char const * fragment_shader_path_ = "./Shaders/FragmentShader.glsl";
 
+    std::vector<std::vector<std::string>> renderMeshBatch_(std::function<GeneralMesh*()> next_mesh, bool own_meshes,
+        const std::string path, const std::string prefix);
+
+    // consumer of the rendered frames; gets them in the camera order. Might submit tasks to the encoder
+    typedef std::function<void(Frame& frame, ImageEncoderPool& encoder)> FrameSink;
+    // renders all the image cameras with the current backend. With owned_frames == false the sink might get
+    // views into the mapped GL memory instead of the copies.
+    // Returns the results of the tasks submitted by the sink in the submission order
+    std::vector<int> renderFrames_(bool owned_frames, const FrameSink& sink);
+    std::vector<int> renderFramesSoftware_(const FrameSink& sink);
+    void loadSoftwareGeometry_(SoftwareRasterizer& rasterizer);
+
+    // feed the sink -- a camera at a time (or a layered pass) or an atlas at a time
+    void renderCamerasToSink_(bool owned_frames, const FrameSink& sink, ImageEncoderPool& encoder);
+    void renderAtlasesToSink_(bool owned_frames, const FrameSink& sink, ImageEncoderPool& encoder);
+    // depth & face indices are read back and multisampling is resolved by the per-camera rendering only
+    bool perCameraOutputs_() const { return depth_export_ || face_idx_export_ || multisample_samples_ > 1; }
+    // distinct sizes of the image cameras. Atlas & layered passes need a single one
+    std::vector<ImageSize> imageSizes_() const;
+    // tight near & far planes for every image camera while the depth is exported -- its precision isn't wasted
+    // on the empty space. Returns the planes of the cameras to be restored after the render call
+    typedef std::vector<std::pair<CameraRig::Handle, glm::vec2>> ClippingPlanes;
+    ClippingPlanes fitClippingPlanes_();
+    void restoreClippingPlanes_(const ClippingPlanes& user_planes);
+
+    // session: context & scene that survive between render calls
+    bool openSession_();
+    void closeSession_();
+    bool initRenderContext_();
+
     // Scene preparation
-    void setUpScene_();
-    void createTargetObjectVAO_();
+    // false if the object can't be uploaded
+    bool setUpScene_();
+    // re-uploads the target if the object or shaders have changed. False if it can't be uploaded
+    bool updateScene_();
+    bool createTargetObjectVAO_();
+    // (re-)fills the buffers of the existing VAO
+    bool uploadTargetObjectData_();
+    // one vec4 per face, provoking (last) corner of the per-corner data
+    template<typename VertexType>
+    bool uploadFaceAttributes_(const std::vector<VertexType>& per_corner, glm::vec3 VertexType::* attribute);
+    // vertex pulling & per-face data go through buffer textures: GL 3.3 guarantees only 65536 texels
+    static bool checkBufferTextureSize_(std::size_t n_texels);
+    void deleteTargetObjectVAO_();
+    // thread-safe: doesn't touch GL
+    static void prepareTargetObjectData_(GeneralMesh* object, Shader::ShaderTypes vertex_shader_type);
     void createCameraObjectVAO_();
     void createShaders_();
-    void setUpTargetObjectColor_();
+    // buffers of the shared uniform blocks, bound to their points for the whole session
+    void createUniformBuffers_();
+    void deleteUniformBuffers_();
+    static void updateUniformBuffer_(unsigned int buffer, const void* data, std::size_t size);
+    // Transform block holds the identity of the target object between the draws of the camera models
+    void resetObjectTransform_();
+    void setUpTargetObjectColor_(Shader& shader);
     void setUpLight_();
+    // camera of the default image size looking at the default target, see addCameraToPosition() for dist
+    Camera createImageCamera_(glm::vec3 position, float dist);
     Camera createDefaultTargetCamera_();
 
     // called every frame
     void clearBackground_();
-    void cameraParamsToShader_(Shader& shader, Camera& camera);
-    void drawMainObject_(Shader& shader);
+    // one sub-update of the Camera block serves all the programs
+    void cameraParamsToUniforms_(const Camera& camera);
+    void drawMainObject_(Shader& shader, int n_instances = 1);
+    // cameras [first_camera, first_camera + n_cameras) go to the layers of the layered framebuffer
+    void drawLayeredPass_(std::size_t first_camera, std::size_t n_cameras);
     void drawImageCameraObjects_(Shader& shader);
 
     // context set-up
-    GLFWwindow* initWindowContext_(bool visible);
-    void initCustomBuffer_();
+    bool initWindowContext_(bool visible);
+    // framebuffer of the given size from the pool, (re-)equipped for the current outputs.
+    // face_idx adds the face index attachment, or removes it if not set; multisample sets up MSAA buffers for the color
+    RenderTarget& initRenderTarget_(ImageSize size, bool face_idx, bool multisample = false);
+    // framebuffers of the pool are created beforehand, a camera resized meanwhile gets its own on the first use
+    RenderTarget& renderTarget_(const Camera& camera, bool face_idx, bool multisample = false);
+    void deleteRenderTargets_();
     void registerCallbacks_(GLFWwindow* window);
-    void cleanAndCloseContext_();
+    // false (and nothing is released) if the context can't be made current on the calling thread
+    bool cleanAndCloseContext_();
+    // (re-)creates the layered shader and buffers of the given size when needed. False if the layered rendering is not possible
+    bool initLayeredRendering_(ImageSize size);
+    void deleteLayeredRendering_();
+    static bool hasGLExtension_(const char* name);
+    // layout of the atlas for the current cameras of the given size. False if no more than one camera fits
+    bool initAtlasBuffers_(ImageSize tile_size);
+    void deleteAtlasBuffers_();
+
+    // async readback through the ring of pixel buffers
+    // buffers of the current outputs grow to fit n_pixels. Not while the transfers are in flight!
+    void initReadbackBuffers_(std::size_t n_pixels);
+    // ring of readback_ring_size_ buffers
+    static void reserveReadbackBuffers_(unsigned int* buffers, std::size_t& reserved_size, std::size_t size);
+    void deleteReadbackBuffers_();
+    void startReadback_(std::size_t slot, int width, int height);
+    // hands the pixels over to the sink. Nothing is passed on if the transfer has failed
+    void finishReadback_(std::size_t slot, const Camera& camera, bool owned_frames,
+        const FrameSink& sink, ImageEncoderPool& encoder);
+    // every tile of the atlas goes to the sink as a separate frame
+    void finishAtlasReadback_(std::size_t slot, const std::vector<unsigned int>& camera_ids, bool owned_frames,
+        const FrameSink& sink, ImageEncoderPool& encoder);
+    // 3 channels
+    static ImageView rgbImageView_(const unsigned char* data, int width, int height, int stride, unsigned int camera_id);
+
+    // depth export
+    // sampleable depth texture instead of the renderbuffer of the target
+    void initDepthExport_(RenderTarget& target);
+    // window depth [0, 1] => metric depth in the pooled buffer of the frame
+    void setFrameDepth_(Frame& frame, const float* window_depth, const Camera& camera, int width, int height,
+        ImageEncoderPool& encoder);
+    static int saveDepthToFile_(const std::string filename, DepthFormats format, float png_depth_scale, 
+        int png_compression_level, const ImageView& depth);
+    // depth * png_depth_scale rounded & clamped to the 16-bit range, tightly packed
+    static std::vector<unsigned short> scaledDepth16_(const ImageView& depth, float png_depth_scale);
+    static const char* depthFileExtension_(DepthFormats format);
+
+    // face index export
+    // R32UI attachment of the target is added or removed
+    void initFaceIndexExport_(RenderTarget& target, bool attach);
+    static int saveFaceIndicesToFile_(const std::string filename, FaceIndexFormats format, const ImageView& face_idx);
+    static const char* faceIndexFileExtension_(FaceIndexFormats format);
+
+    // multisampling
+    // (re-)creates the multisampled framebuffer of the target for the current outputs, deletes it if multisampling is off
+    void initMultisampling_(RenderTarget& target);
+    void deleteMultisampling_(RenderTarget& target);
+    // color is blitted (averaged), depth & face index are copied from a single sample. Leaves target.framebuffer bound
+    void resolveMultisampling_(const RenderTarget& target);
+
+    // face visibility
+    std::vector<FaceVisibility> computeFaceVisibilityGL_();
+    std::vector<FaceVisibility> computeFaceVisibilitySoftware_();
+    // bitset target for the cameras_per_batch cameras, rows_per_camera rows each. False if it can't be created
+    bool initFaceVisibility_(int width, int rows_per_camera, std::size_t cameras_per_batch);
+    void deleteFaceVisibility_();
+
+    // single 32-bit channel
+    static ImageView scalarImageView_(const unsigned char* data, int width, int height, unsigned int camera_id);
+    // copy of the (already transferred) content of the pixel pack buffer. nullptr if the mapping has failed
+    ImageEncoderPool::PixelBuffer copyReadbackBuffer_(unsigned int buffer, std::size_t size, ImageEncoderPool& encoder);
 
     // saver!
-    int saveRGBTexToFile_(const std::string filename, unsigned int texture_id);
+    static int saveImageToFile_(const std::string filename, ImageFormats format, int png_compression_level, const ImageView& image);
+    static const char* imageFileExtension_(ImageFormats format);
+    // 255 where a face is visible
+    static int saveMaskToFile_(const std::string filename, const ImageView& face_idx);
+    DatasetWriter::View datasetView_(const Camera& camera);
     
     // View Control
     void processInput_(GLFWwindow *window);
-    // callbacks should be static!
+    // callbacks should be static! The instance is the user pointer of the window
     static void framebufferSizeCallback_(GLFWwindow* window, int width, int height);
     static void mouseCallback(GLFWwindow* window, double xpos, double ypos);
     static void scrollCallback(GLFWwindow* window, double xoffset, double yoffset);
     
     // Vars ------------------------------
+    // context
+    ContextBackend* context_ = nullptr;
+    ContextBackend::BackendTypes context_backend_type_ = ContextBackend::typeFromEnvironment(ContextBackend::GLFW_BACKEND);
+    RenderBackendTypes render_backend_type_ = GL_RENDER_BACKEND;
+
     // tools
     // pointers are used to init shader later than in constructor
     Shader* shader_ = nullptr;
-    Shader* simple_shader_ = nullptr;
+    Shader* simple_shader_ = nullptr;  // camera models of viewScene(), created on demand
     Shader* depthread_shader_ = nullptr;
     glm::vec3 default_camera_position_ = glm::vec3(0.0f, 0.0f, 4.0f);
-    std::vector<Camera> image_cameras_;
-    static Camera* view_camera_;
+    CameraRig image_cameras_;
+    Camera* view_camera_ = nullptr;
     Shader::ShaderTypes vertex_shader_type_, fragment_shader_type_;
+    ShadingParams shading_params_ = ShadingParams::defaultParams();
 
     // appearence control
     float win_width_ = 1024;
     float win_height_ = 1024;
+    int default_image_width_ = 1024;
+    int default_image_height_ = 1024;
 
     // target
     GeneralMesh* object_;
@@ -112,16 +409,169 @@ private:
     unsigned int object_texture_ = 0;
     unsigned int object_vertex_buffer_ = 0;
     unsigned int object_element_buffer_ = 0;
+    // all the shaders draw from the indexed vertices above, the rest is looked up by the face or corner index:
+    // per-face ids/colors by gl_PrimitiveID, TEXTURE pulls positions & normals by the corner index and gets uv per corner
+    unsigned int object_face_attribute_buffer_ = 0;
+    unsigned int object_face_attribute_texture_ = 0;
+    unsigned int object_uv_buffer_ = 0;
+    unsigned int object_vertex_texture_ = 0;
+    unsigned int object_element_texture_ = 0;
+    // unit 0 is for Tex1
+    static constexpr int face_attribute_texture_unit_ = 1;
+    static constexpr int vertex_texture_unit_ = 1;
+    static constexpr int element_texture_unit_ = 2;
+
+    // custom buffers: a framebuffer per image size
+    std::map<ImageSize, RenderTarget> render_targets_;
+
+    // shared uniform blocks, see Shader::UniformBlockBindings.
+    // std140 layouts: vec3 is aligned to 16 bytes, a float may take its 4th component
+    struct CameraBlock
+    {
+        glm::mat4 view;
+        glm::mat4 projection;
+        glm::vec4 eye_pos;
+    };
+    struct TransformBlock
+    {
+        glm::mat4 model;
+        glm::mat4 normal_matrix;
+    };
+    struct MaterialBlock
+    {
+        float shininess;
+        float padding_0[3];
+        glm::vec3 specular;
+        float padding_1;
+        glm::vec3 diffuse;
+        float padding_2;
+    };
+    struct DirectionalLightStd140
+    {
+        glm::vec3 direction;
+        float padding_0;
+        glm::vec3 ambient;
+        float padding_1;
+        glm::vec3 diffuse;
+        float padding_2;
+        glm::vec3 specular;
+        float padding_3;
+    };
+    struct PointLightStd140
+    {
+        glm::vec3 position;
+        float padding_0;
+        glm::vec3 ambient;
+        float padding_1;
+        glm::vec3 diffuse;
+        float padding_2;
+        glm::vec3 specular;
+        float attenuation_constant;
+        float attenuation_linear;
+        float attenuation_quadratic;
+        float padding_3[2];
+    };
+    struct LightsBlock
+    {
+        DirectionalLightStd140 directional_light;
+        PointLightStd140 point_lights[ShadingParams::kPointLights];
+    };
+    static_assert(sizeof(CameraBlock) == 144, "Camera block should follow std140 layout");
+    static_assert(sizeof(TransformBlock) == 128, "Transform block should follow std140 layout");
+    static_assert(sizeof(MaterialBlock) == 48, "MaterialBlock block should follow std140 layout");
+    static_assert(sizeof(LightsBlock) == 64 + 80 * ShadingParams::kPointLights, "Lights block should follow std140 layout");
+    unsigned int camera_uniform_buffer_ = 0;
+    unsigned int transform_uniform_buffer_ = 0;
+    unsigned int material_uniform_buffer_ = 0;
+    unsigned int lights_uniform_buffer_ = 0;
+
+    // layered rendering
+    static constexpr std::size_t layered_max_cameras_ = 16;    // should match the layered vertex shaders
+    // std140 layout of LayeredCameras uniform block
+    struct LayeredCamerasBlock
+    {
+        glm::mat4 views[layered_max_cameras_];
+        glm::mat4 projections[layered_max_cameras_];
+        glm::vec4 eye_positions[layered_max_cameras_];
+    };
+    std::size_t cameras_per_pass_ = 1;
+    bool layered_supported_ = false;
+    Shader* layered_shader_ = nullptr;
+    unsigned int layered_cameras_buffer_ = 0;
+    unsigned int layered_framebuffer_ = 0;
+    unsigned int layered_color_buffer_ = 0;
+    unsigned int layered_depth_buffer_ = 0;
+    std::size_t layered_buffer_layers_ = 0;
+    ImageSize layered_buffer_size_;
+    unsigned int layer_read_framebuffer_ = 0;  // single layer is attached for the readback
+
+    // atlas rendering
+    bool atlas_rendering_ = false;
+    int atlas_max_size_ = 4096;
+    int atlas_width_ = 0;
+    int atlas_height_ = 0;
+    int atlas_tile_width_ = 0;
+    int atlas_tile_height_ = 0;
+    std::size_t atlas_columns_ = 0;
+    std::size_t atlas_tiles_ = 0;   // cameras per atlas
+    unsigned int atlas_framebuffer_ = 0;
+    unsigned int atlas_color_buffer_ = 0;
+    unsigned int atlas_depth_buffer_ = 0;
+
+    // readback ring: camera N+1 is rendered while pixels of camera N are still in transit
+    static constexpr std::size_t readback_ring_size_ = 2;
+    unsigned int readback_buffers_[readback_ring_size_] = { 0 };
+    std::size_t readback_buffer_size_ = 0;
+    GLsync readback_fences_[readback_ring_size_] = { nullptr };
+    unsigned int atlas_readback_buffers_[readback_ring_size_] = { 0 };
+    GLsync atlas_readback_fences_[readback_ring_size_] = { nullptr };
+
+    // image files
+    ImageFormats image_format_ = IMAGE_PNG;
+    int png_compression_level_ = 8;
+
+    // depth export
+    static constexpr float min_near_to_far_ratio_ = 0.001f;
+    bool depth_export_ = false;
+    DepthFormats depth_format_ = DEPTH_NPY;
+    float depth_png_scale_ = 1000.0f;
+    unsigned int depth_readback_buffers_[readback_ring_size_] = { 0 };  // shares the fences with the color
+    std::size_t depth_readback_buffer_size_ = 0;
+
+    // face index export
+    bool face_idx_export_ = false;
+    FaceIndexFormats face_idx_format_ = FACE_IDX_PFID;
+    unsigned int face_idx_readback_buffers_[readback_ring_size_] = { 0 };  // shares the fences with the color
+    std::size_t face_idx_readback_buffer_size_ = 0;
+
+    // multisampling: buffers are in the render targets
+    int multisample_samples_ = 0;   // requested
+    Shader* multisample_resolve_shader_ = nullptr;
+    unsigned int multisample_vertex_array_ = 0;     // empty: full-screen triangle is generated from gl_VertexID
+
+    // face visibility
+    static constexpr int visibility_max_width_ = 4096;  // in 32-face words
+    Shader* visibility_shader_ = nullptr;
+    unsigned int visibility_framebuffer_ = 0;
+    unsigned int visibility_buffer_ = 0;
+    unsigned int visibility_vertex_array_ = 0;  // empty: the points are generated from gl_VertexID
+    int visibility_buffer_width_ = 0;
+    int visibility_buffer_height_ = 0;
+
+    // background encoding
+    ImageEncoderPool* encoder_ = nullptr;
+    std::size_t encoder_threads_ = ImageEncoderPool::defaultThreadsNumber();
+    std::size_t encoder_queue_size_ = 8;
 
-    // custom buffers
-    unsigned int framebuffer_ = 0;
-    unsigned int texture_color_buffer_ = 0;
-    unsigned int depth_render_buffer_ = 0;
+    // session state
+    bool session_open_ = false;
+    GeneralMesh* scene_object_ = nullptr;   // what is uploaded to GPU
+    Shader::ShaderTypes scene_vertex_shader_type_, scene_fragment_shader_type_;
 
     // keep track of the mouse
-    static float yaw_, pitch_;
-    static float lastX_, lastY_;
-    static bool first_mouse_;
+    float lastX_ = 400;
+    float lastY_ = 300;
+    bool first_mouse_ = true;
     
     // keep track of rendering speed for camera speed adjustment
     float delta_time_ = 0.0f;    // Time between current frame and last frame
@@ -0,0 +1,35 @@
+#pragma once
+// Keeps the rendering state of the Photographer warm between render calls:
+// the context, compiled shaders, framebuffers, readback buffers and the uploaded mesh
+// live until the session is closed, so re-rendering after a camera change costs only draw & readback.
+//
+// The mesh is re-uploaded only when the target object or the shaders of the Photographer change.
+// One session per Photographer at a time; viewScene() is not available while the session is open
+
+#include "Photographer.h"
+
+class RenderSession
+{
+public:
+    explicit RenderSession(Photographer& photographer);
+    ~RenderSession();
+
+    RenderSession(const RenderSession&) = delete;
+    RenderSession& operator=(const RenderSession&) = delete;
+
+    // false if the context could not be created
+    bool isOpen() const;
+    void close();
+
+    std::vector<std::string> renderToImages(const std::string path = "./", const std::string prefix = "view_");
+    std::vector<Frame> renderToFrames();
+    void renderToCallback(Photographer::FrameCallback on_frame);
+    int renderToArchive(const std::string filename);
+    int renderToDataset(const std::string path, DatasetWriter::Formats formats = DatasetWriter::NERF_AND_COLMAP, 
+        bool with_masks = false);
+    std::vector<FaceVisibility> computeFaceVisibility();
+
+private:
+    Photographer& photographer_;
+    bool owner_ = false;
+};
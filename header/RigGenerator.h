@@ -0,0 +1,28 @@
+#pragma once
+// Camera positions of the common rigs, for Photographer::addCameraRig().
+//
+// Positions are appended to the given vector, which is reserved once for the whole rig.
+// Every point is computed from its integer index, so the counts are exact and the steps don't drift
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+class RigGenerator
+{
+public:
+    // n points spread evenly over the sphere along the golden-angle spiral
+    static void fibonacciSphere(std::vector<glm::vec3>& positions, int n,
+        float radius = 1.0f, glm::vec3 center = glm::vec3(0.0f));
+    // n_latitudes x n_longitudes grid. Latitudes (degrees) go from min to max inclusive, the longitudes cover the full circle
+    static void latLongGrid(std::vector<glm::vec3>& positions, int n_latitudes, int n_longitudes,
+        float min_latitude = -60.0f, float max_latitude = 60.0f, float radius = 1.0f, glm::vec3 center = glm::vec3(0.0f));
+    // a Fibonacci sphere of n_per_shell points for every radius, each direction shifted randomly by up to jitter
+    // (fraction of the radius). Same seed -- same rig
+    static void jitteredShells(std::vector<glm::vec3>& positions, int n_per_shell, const std::vector<float>& radii,
+        float jitter = 0.05f, unsigned int seed = 0, glm::vec3 center = glm::vec3(0.0f));
+    // n points on the circle at the height y, as Photographer::addCameraRingRoutine() places them
+    static void ring(std::vector<glm::vec3>& positions, int n, float y = 0.0f, float radius = 1.0f);
+    // (2 * half_steps + 1) points along every axis, step apart, centered at center. x changes first
+    static void shakerGrid(std::vector<glm::vec3>& positions, glm::vec3 center, glm::ivec3 half_steps, glm::vec3 step);
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <unordered_map>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -18,6 +19,14 @@
 #include "../Shaders/FaceIdxFragmentShader.h"
 #include "../Shaders/FlatVertexShader.h"
 #include "../Shaders/FlatFragmentShader.h"
+#include "../Shaders/NoTextureLayeredVertexShader.h"
+#include "../Shaders/TextureLayeredVertexShader.h"
+#include "../Shaders/FaceIdxLayeredVertexShader.h"
+#include "../Shaders/FlatLayeredVertexShader.h"
+#include "../Shaders/FaceVisibilityVertexShader.h"
+#include "../Shaders/FaceVisibilityFragmentShader.h"
+#include "../Shaders/MultisampleResolveVertexShader.h"
+#include "../Shaders/MultisampleResolveFragmentShader.h"
 
 
 
@@ -37,22 +46,71 @@ public:
         FACEIDX_SHADER, //read front face id after fragment shader is finished
         FLAT_SHADER
     };
-    Shader(ShaderTypes vertex_shader_type, ShaderTypes fragment_shader_type);
+    // internal passes of the Photographer that don't draw the object
+    enum PassShaderTypes
+    {
+        FACE_VISIBILITY_PASS,   // face index image => per-camera bitset of the visible faces
+        MULTISAMPLE_RESOLVE_PASS    // single sample of the multisampled depth & face index => single-sampled framebuffer
+    };
+    // binding points of the std140 uniform blocks shared by all the programs: a block is bound to its point at link time,
+    // so one buffer per block serves every program. Buffers are filled by Photographer
+    enum UniformBlockBindings
+    {
+        LAYERED_CAMERAS_BINDING = 0,    // LayeredCameras: views, projections & eye positions of the layered pass
+        CAMERA_BINDING = 1,             // Camera: view, projection, eye_pos
+        TRANSFORM_BINDING = 2,          // Transform: model, normal_matrix
+        MATERIAL_BINDING = 3,           // MaterialBlock: material
+        LIGHTS_BINDING = 4              // Lights: directional_light, point_lights
+    };
+    // location of a loose (not in a block) uniform, resolved at link time. -1 if the program doesn't have it
+    struct Uniform
+    {
+        int location = -1;
+    };
+
+    // layered version renders one camera per instance into the layers of a texture array.
+    // Requires GL_ARB_shader_viewport_layer_array; not available for DEFAULT_SHADER
+    Shader(ShaderTypes vertex_shader_type, ShaderTypes fragment_shader_type, bool layered = false);
+    explicit Shader(PassShaderTypes pass_type);
     Shader(const GLchar* vertexPath, const GLchar* fragmentPath);
     ~Shader();
     // Activate the shader
     void use();
-    // working with uniforms
-    void setUniform(const std::string &name, int value) const;
-    void setUniform(const std::string &name, float value) const;
-    void setUniform(const std::string &name, glm::mat4 value) const;
-    void setUniform(const std::string &name, glm::vec3 value) const;
-    void setUniform(const std::string &name, glm::vec4 value) const;
+    // working with uniforms. Handles are for the per-draw updates, names are looked up in the table built at link time
+    Uniform getUniform(const std::string &name) const;
+    void setUniform(Uniform uniform, int value) const;
+    void setUniform(Uniform uniform, float value) const;
+    void setUniform(Uniform uniform, const glm::mat4& value) const;
+    void setUniform(Uniform uniform, const glm::vec3& value) const;
+    void setUniform(Uniform uniform, const glm::vec4& value) const;
+    void setUniform(const std::string &name, int value) const { setUniform(getUniform(name), value); }
+    void setUniform(const std::string &name, float value) const { setUniform(getUniform(name), value); }
+    void setUniform(const std::string &name, glm::mat4 value) const { setUniform(getUniform(name), value); }
+    void setUniform(const std::string &name, glm::vec3 value) const { setUniform(getUniform(name), value); }
+    void setUniform(const std::string &name, glm::vec4 value) const { setUniform(getUniform(name), value); }
     // Program ID
     unsigned int getID() { return this->ID_; }
+    bool isLinked() const;
+
+    // Linked programs are cached on disk (glGetProgramBinary) under the hash of the sources and the driver strings,
+    // so the next runs load the binary instead of compiling. Binaries the driver rejects (e.g. after an update
+    // that kept the version string) are rebuilt and overwritten. Silently off if the driver has no binary formats.
+    // Process-wide; "" disables the cache. Default is PHOTOGRAPHER_SHADER_CACHE env variable,
+    // or photographer_shader_cache in the temp directory
+    static void setBinaryCacheDir(const std::string& path);
+    static std::string getBinaryCacheDir();
   
 private:
-    void createProgram_(unsigned int vertex_shader, unsigned int fragment_shader);
+    // loads the program from the cache or builds it from the sources (and caches it)
+    void buildProgram_(const char* vertex_code, const char* fragment_code);
+    void createProgram_(unsigned int vertex_shader, unsigned int fragment_shader, bool retrievable = false);
+    // "" if the cache is off or not supported
+    static std::string binaryCacheFile_(const char* vertex_code, const char* fragment_code);
+    // false if the file is missing, broken or rejected by the driver -- no program is left then
+    bool loadProgramBinary_(const std::string& cache_file);
+    void saveProgramBinary_(const std::string& cache_file) const;
+    // locations of the loose uniforms & binding points of the shared blocks
+    void resolveUniforms_();
 
     static std::string readCodeFile_(const GLchar* path);
 
@@ -61,6 +119,7 @@ private:
     static unsigned int compileFragmentShader_(const char* shader_code);
     
     unsigned int ID_;
+    std::unordered_map<std::string, int> uniform_locations_;
 
     // default shaders
     const char *default_vertex_shader_source_ = SHADER_CODE_GLSL_TO_STRING(330,
@@ -0,0 +1,81 @@
+#pragma once
+// Material & lights of the Phong shaders (NOTEXTURE_SHADER, TEXTURE_SHADER).
+// The structs mirror the ones declared in the fragment shaders
+
+#include <cstddef>
+#include <glm/glm.hpp>
+
+struct Material
+{
+    float shininess;
+    glm::vec3 specular;
+    glm::vec3 diffuse;
+};
+
+struct DirectionalLight
+{
+    glm::vec3 direction;
+
+    glm::vec3 ambient;   // control the intensity
+    glm::vec3 diffuse;   // main light color
+    glm::vec3 specular;  // usually just white
+};
+
+struct PointLight
+{
+    glm::vec3 position;
+
+    glm::vec3 ambient;   // control the intensity
+    glm::vec3 diffuse;   // main light color
+    glm::vec3 specular;  // usually just white
+
+    float attenuation_constant;
+    float attenuation_linear;
+    float attenuation_quadratic;
+};
+
+struct ShadingParams
+{
+    static const std::size_t kPointLights = 2;  // NR_POINT_LIGHTS in the shaders
+
+    Material material;
+    DirectionalLight directional_light;
+    PointLight point_lights[kPointLights];
+
+    // the scene set-up used by Photographer
+    static ShadingParams defaultParams()
+    {
+        ShadingParams params;
+
+        //glm::vec3 color = glm::vec3(1.0f, 0.5f, 0.31f);  coral
+        glm::vec3 color = glm::vec3(0.6f, 0.6f, 0.6f);
+        params.material.diffuse = color;
+        params.material.specular = 0.3f * color;
+        params.material.shininess = 64.0f;
+
+        params.directional_light.direction = glm::vec3(-0.2f, -1.0f, -0.5f);
+        params.directional_light.ambient = glm::vec3(0.2f);
+        params.directional_light.diffuse = glm::vec3(0.7f, 0.7f, 0.7f);
+        params.directional_light.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+
+        glm::vec3 point_light_positions[kPointLights] = {
+            glm::vec3(0.7f,  0.2f,  2.0f),
+            glm::vec3(0.0f,  0.0f, -2.0f)
+        };
+        for (std::size_t i = 0; i < kPointLights; ++i)
+        {
+            PointLight& light = params.point_lights[i];
+            light.position = point_light_positions[i];
+
+            light.ambient = glm::vec3(0.2f);
+            light.diffuse = glm::vec3(0.5f, 0.5f, 0.5f);
+            light.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+
+            light.attenuation_constant = 1.0f;
+            light.attenuation_linear = 0.09f;
+            light.attenuation_quadratic = 0.032f;
+        }
+
+        return params;
+    }
+};
@@ -0,0 +1,137 @@
+#pragma once
+// CPU implementation of the Photographer pipelines: no GL context or GPU is needed.
+//
+// Follows the GL conventions so the images match the GPU output up to the rounding:
+// near/far clipping in clip space, CW triangles are culled, the last vertex is the provoking one,
+// pixel centers are at half-integers, GL_LESS depth test and rows are stored bottom-up.
+//
+// The screen is split into tiles that are rasterized in parallel;
+// edge functions are evaluated for 4 pixels at once (SSE, if available)
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Frame.h"
+#include "Shader.h"
+#include "ShadingParams.h"
+
+class SoftwareRasterizer
+{
+public:
+    // the union of the vertex attributes of all the pipelines
+    struct Vertex
+    {
+        glm::vec3 position;
+        glm::vec3 normal;
+        glm::vec2 uv;
+        glm::vec3 color;    // flat: face id or label color
+    };
+
+    SoftwareRasterizer(int width, int height, std::size_t n_threads);
+    ~SoftwareRasterizer();
+    SoftwareRasterizer(const SoftwareRasterizer&) = delete;
+    SoftwareRasterizer& operator=(const SoftwareRasterizer&) = delete;
+
+    // NOTEXTURE, TEXTURE, FACEIDX and FLAT pipelines
+    static bool isSupported(Shader::ShaderTypes shader_type);
+
+    // cameras of different resolution share the rasterizer and its geometry
+    void setImageSize(int width, int height);
+    void setShaderType(Shader::ShaderTypes shader_type) { shader_type_ = shader_type; }
+    void setShadingParams(const ShadingParams& params) { params_ = params; }
+    // GL_RGB 8-bit texture with the default GL unpack alignment (4). Not copied
+    void setTexture(const unsigned char* data, int width, int height);
+    // 3 indices per triangle. Model matrix is identity, like in Photographer
+    void setGeometry(std::vector<Vertex> vertices, std::vector<unsigned int> indices);
+
+    // writes width * height RGB pixels, bottom row first.
+    // face_idx_out (optional) gets the index of the visible triangle or Frame::background_face_idx for every pixel
+    void render(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& eye_pos, unsigned char* color_out,
+        unsigned int* face_idx_out = nullptr);
+    // window-space depth of the last render in [0, 1], 1 for the background; bottom row first
+    const float* depth() const { return depth_.data(); }
+
+private:
+    static constexpr int tile_size_ = 64;
+    static constexpr std::size_t setup_chunk_size_ = 4096;
+
+    struct ClipVertex
+    {
+        glm::vec4 clip;
+        glm::vec3 world;
+        glm::vec3 normal;
+        glm::vec2 uv;
+    };
+
+    // ready for rasterization in window coordinates
+    struct Triangle
+    {
+        // edge functions e(x, y) = a * x + b * y + c; positive inside
+        float a[3], b[3], c[3];
+        bool top_left[3];   // fill rule: pixels exactly on the edge belong to the top & left edges only
+        float inv_area;
+        float z[3];
+        float inv_w[3];
+        // perspective-correct attributes are interpolated as attr / w
+        glm::vec3 world[3];
+        glm::vec3 normal[3];
+        glm::vec2 uv[3];
+        glm::vec3 flat_color;
+        unsigned int face_idx;  // gl_PrimitiveID
+        int min_x, min_y, max_x, max_y;
+    };
+
+    void transformVertices_(const glm::mat4& view_projection);
+    void setUpTriangles_(std::size_t chunk, std::vector<Triangle>& triangles) const;
+    // clips against near & far planes, emits the result as a fan
+    void clipAndEmit_(const ClipVertex* vertices, const glm::vec3& flat_color, std::vector<Triangle>& triangles) const;
+    bool setUpTriangle_(const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2,
+        const glm::vec3& flat_color, Triangle& triangle) const;
+    void binTriangles_();
+    void rasterizeTile_(std::size_t tile, unsigned char* color_out, unsigned int* face_idx_out);
+    void shadePixel_(const Triangle& triangle, float l0, float l1, float l2, unsigned char* pixel) const;
+    glm::vec3 phong_(const glm::vec3& normal, const glm::vec3& frag_position) const;
+    glm::vec3 sampleTexture_(glm::vec2 uv) const;
+
+    // jobs are distributed dynamically between the workers and the calling thread
+    void parallelFor_(std::size_t n_jobs, const std::function<void(std::size_t)>& job);
+    void runJobs_();
+    void workerLoop_();
+
+    int width_, height_;
+    int tiles_x_, tiles_y_;
+    Shader::ShaderTypes shader_type_ = Shader::NOTEXTURE_SHADER;
+    ShadingParams params_ = ShadingParams::defaultParams();
+    glm::vec3 eye_pos_;
+
+    const unsigned char* texture_ = nullptr;
+    int texture_width_ = 0;
+    int texture_height_ = 0;
+    std::size_t texture_row_size_ = 0;
+
+    std::vector<Vertex> vertices_;
+    std::vector<unsigned int> indices_;
+    std::vector<ClipVertex> clip_vertices_;
+    std::vector<std::vector<Triangle>> chunk_triangles_;
+    std::vector<const Triangle*> triangles_;
+    std::vector<std::vector<unsigned int>> tile_bins_;
+    std::vector<float> depth_;
+
+    // workers
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable start_;
+    std::condition_variable done_;
+    const std::function<void(std::size_t)>* job_ = nullptr;
+    std::size_t n_jobs_ = 0;
+    std::atomic<std::size_t> next_job_;
+    std::size_t generation_ = 0;
+    std::size_t busy_workers_ = 0;
+    bool stop_ = false;
+};
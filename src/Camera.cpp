@@ -1,14 +1,16 @@
 #include "../header/Camera.h"
 
-unsigned int Camera::avalible_camera_id = 1000;
+std::atomic<unsigned int> Camera::avalible_camera_id(1000);
+// static, so the cameras can be assigned
+const glm::vec3 Camera::world_up_ = glm::vec3(0.0f, 1.0f, 0.0f);
 
 Camera::Camera(int screen_width, int screen_height, float field_of_view)
-    :screen_width_(screen_width), screen_height_(screen_height), field_of_view_y_(field_of_view)
+    :screen_width_(screen_width), screen_height_(screen_height), field_of_view_y_(field_of_view),
+    principal_point_(screen_width / 2.0f, screen_height / 2.0f)
 {
     mode_ = FREE_MODE;
 
-    ID_ = Camera::avalible_camera_id;
-    Camera::avalible_camera_id++;
+    ID_ = Camera::avalible_camera_id++;
 
     position_ = glm::vec3(0.0f, 0.0f, 0.0f);
     yaw_ = -90.0f;
@@ -21,45 +23,73 @@ Camera::~Camera()
 {
 }
 
-glm::mat4 Camera::getGlViewMatrix()
+const glm::mat4& Camera::getGlViewMatrix() const
 {
-    return glm::lookAt(position_, position_ + front_, up_);
+    if (pose_dirty_)
+    {
+        updatePoseMatrices_();
+    }
+    return view_matrix_;
 }
 
-glm::mat4 Camera::getCVExtrinsicsMatrix()
+const glm::mat4& Camera::getGlCameraToWorldMatrix() const
 {
-    glm::mat4 extrinsics = getGlViewMatrix();
-
-    // now rotate the whole final scene to match opencv coordinate system orientation 
-    glm::mat4 turn_y_180 = glm::mat4(1.0);
-    turn_y_180[0][0] = -1.0f;
-    turn_y_180[2][2] = -1.0f;
-    extrinsics = extrinsics * turn_y_180;
-
-    return extrinsics;
+    if (pose_dirty_)
+    {
+        updatePoseMatrices_();
+    }
+    return camera_to_world_matrix_;
 }
 
-glm::mat4 Camera::getGlProjectionMatrix()
+const glm::mat4& Camera::getCVExtrinsicsMatrix() const
 {
-    return glm::perspective(glm::radians(field_of_view_y_), screen_width_ / screen_height_, 0.1f, 100.0f);
+    if (pose_dirty_)
+    {
+        updatePoseMatrices_();
+    }
+    return extrinsics_matrix_;
 }
 
-glm::mat3 Camera::getCVIntrinsicsMatrix()
+const glm::mat4& Camera::getGlProjectionMatrix() const
 {
-    glm::mat3 intrinsics = glm::mat3(1.0f);  // identity
-
-    float pix_focal = screen_height_ / (2 * tan(glm::radians(field_of_view_y_) / 2));
+    if (intrinsics_dirty_)
+    {
+        updateIntrinsicsMatrices_();
+    }
+    return projection_matrix_;
+}
 
-    // column-wise storage: mat[col][row]
-    intrinsics[0][0] = pix_focal;
-    intrinsics[1][1] = pix_focal;
-    intrinsics[2][0] = screen_width_ / 2;
-    intrinsics[2][1] = screen_height_ / 2;
+const glm::mat3& Camera::getCVIntrinsicsMatrix() const
+{
+    if (intrinsics_dirty_)
+    {
+        updateIntrinsicsMatrices_();
+    }
+    return intrinsics_matrix_;
+}
 
-    return intrinsics;
+void Camera::getRigMatrices(const Camera* cameras, std::size_t n, 
+    glm::mat4* views, glm::mat4* projections, glm::vec4* eye_positions)
+{
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        const Camera& camera = cameras[i];
+        if (views != nullptr)
+        {
+            views[i] = camera.getGlViewMatrix();
+        }
+        if (projections != nullptr)
+        {
+            projections[i] = camera.getGlProjectionMatrix();
+        }
+        if (eye_positions != nullptr)
+        {
+            eye_positions[i] = glm::vec4(camera.position_, 1.0f);
+        }
+    }
 }
 
-glm::vec4 Camera::getGlViewPortVector()
+glm::vec4 Camera::getGlViewPortVector() const
 {
     return glm::vec4(0.0f, 0.0f, screen_width_, screen_height_);
 }
@@ -72,6 +102,7 @@ float Camera::getFovy() const {
 void Camera::setPosition(glm::vec3 pos)
 {
     position_ = pos;
+    invalidatePose_();
 
     if (mode_ == TARGET_MODE)
     {
@@ -101,6 +132,53 @@ void Camera::setTarget(glm::vec3 target)
     updateFrontByTarget_();
 }
 
+void Camera::setPose(glm::vec3 pos, glm::vec3 target)
+{
+    mode_ = TARGET_MODE;
+    position_ = pos;
+    target_ = target;
+    updateFrontByTarget_();
+}
+
+void Camera::setResolution(int screen_width, int screen_height)
+{
+    if (screen_width <= 0 || screen_height <= 0)
+    {
+        std::cout << "WARNING::CAMERA " << ID_ << "::Invalid resolution " << screen_width << "x" << screen_height
+            << ". Ignored" << std::endl;
+        return;
+    }
+
+    screen_width_ = screen_width;
+    screen_height_ = screen_height;
+    principal_point_ = glm::vec2(screen_width / 2.0f, screen_height / 2.0f);
+    invalidateIntrinsics_();
+}
+
+void Camera::setPrincipalPoint(float cx, float cy)
+{
+    principal_point_ = glm::vec2(cx, cy);
+    invalidateIntrinsics_();
+}
+
+void Camera::setClippingPlanes(float near_plane, float far_plane)
+{
+    if (near_plane <= 0.0f || far_plane <= near_plane)
+    {
+        std::cout << "WARNING::CAMERA " << ID_ << "::Invalid clipping planes " << near_plane << " " << far_plane 
+            << ". Ignored" << std::endl;
+        return;
+    }
+
+    // fitted on every render -- usually to the same values
+    if (near_plane != near_plane_ || far_plane != far_plane_)
+    {
+        near_plane_ = near_plane;
+        far_plane_ = far_plane;
+        invalidateIntrinsics_();
+    }
+}
+
 void Camera::movePosition(Directions direction, float step_size_multiplier)
 {
     float velocity = movement_speed_ * step_size_multiplier;
@@ -126,6 +204,7 @@ void Camera::movePosition(Directions direction, float step_size_multiplier)
             position_ -= right_ * velocity;
             break;
     }
+    invalidatePose_();
 
     if (mode_ == TARGET_MODE)
     {
@@ -164,26 +243,32 @@ void Camera::zoom(float delta)
     // check boundaries
     if (field_of_view_y_ <= 1.0f)             field_of_view_y_ = 1.0f;
     if (field_of_view_y_ >= default_fov_)      field_of_view_y_ = default_fov_;
+    invalidateIntrinsics_();
 }
 
-void Camera::saveParamsForOpenCV(const std::string path, const std::string prefix)
+void Camera::saveParamsForOpenCV(const std::string path, const std::string prefix) const
 {
-    glm::mat4 extrinsics = getCVExtrinsicsMatrix();
-    glm::mat3 intrinsics = getCVIntrinsicsMatrix();
+    const glm::mat4& extrinsics = getCVExtrinsicsMatrix();
+    const glm::mat3& intrinsics = getCVIntrinsicsMatrix();
 
     // Save. Very hardcore approach. But no new dependencies!
+    // Lines end with '\n' -- the file is flushed once, on close
     std::ofstream xml_file;
     xml_file.open(path + "/" + prefix  +std::to_string(ID_) + ".xml");
 
-    xml_file << "<?xml version=\"1.0\"?>" << std::endl
-        << "<opencv_storage>" << std::endl;
+    xml_file << "<?xml version=\"1.0\"?>" << '\n'
+        << "<opencv_storage>" << '\n';
+
+    // intrinsics are in pixels of this image size
+    xml_file << "<image_width>" << getWidth() << "</image_width>" << '\n'
+        << "<image_height>" << getHeight() << "</image_height>" << '\n';
 
     // extrinsic
-    xml_file << "<CameraMatrix type_id=\"opencv-matrix\">" << std::endl
-        << "\t<rows>3</rows>" << std::endl
-        << "\t<cols>4</cols>" << std::endl
-        << "\t<dt>d</dt>" << std::endl
-        << "\t<data>" << std::endl;
+    xml_file << "<CameraMatrix type_id=\"opencv-matrix\">" << '\n'
+        << "\t<rows>3</rows>" << '\n'
+        << "\t<cols>4</cols>" << '\n'
+        << "\t<dt>d</dt>" << '\n'
+        << "\t<data>" << '\n';
     for (int i = 0; i < 3; ++i)
     {
         xml_file << "\t\t";
@@ -191,15 +276,15 @@ void Camera::saveParamsForOpenCV(const std::string path, const std::string prefi
         {
             xml_file << extrinsics[j][i] << " ";     // colwise storage
         }
-        xml_file << std::endl;
+        xml_file << '\n';
     }
-    xml_file << "\t</data>\n</CameraMatrix>" << std::endl;
+    xml_file << "\t</data>\n</CameraMatrix>" << '\n';
     
-    xml_file << "<Intrinsics type_id=\"opencv-matrix\">" << std::endl
-        << "\t<rows>3</rows>" << std::endl
-        << "\t<cols>3</cols>" << std::endl
-        << "\t<dt>d</dt>" << std::endl
-        << "\t<data>" << std::endl;
+    xml_file << "<Intrinsics type_id=\"opencv-matrix\">" << '\n'
+        << "\t<rows>3</rows>" << '\n'
+        << "\t<cols>3</cols>" << '\n'
+        << "\t<dt>d</dt>" << '\n'
+        << "\t<data>" << '\n';
 
     for (int i = 0; i < 3; ++i)
     {
@@ -208,23 +293,61 @@ void Camera::saveParamsForOpenCV(const std::string path, const std::string prefi
         {
             xml_file << intrinsics[j][i] << " ";    // colwise storage
         }
-        xml_file << std::endl;
+        xml_file << '\n';
     }
     
-    xml_file << "\t</data>\n</Intrinsics>" << std::endl;
+    xml_file << "\t</data>\n</Intrinsics>" << '\n';
 
     // No distortion
-    xml_file << "<Distortion type_id=\"opencv-matrix\">" << std::endl
-        << "\t<rows>8</rows>" << std::endl
-        << "\t<cols>1</cols>" << std::endl
-        << "\t<dt>d</dt>" << std::endl
-        << "\t<data> 0. 0. 0. 0. 0. 0. 0. 0.</data>" << std::endl
-        << "</Distortion>" << std::endl;
-
-    xml_file << "</opencv_storage>" << std::endl;
+    xml_file << "<Distortion type_id=\"opencv-matrix\">" << '\n'
+        << "\t<rows>8</rows>" << '\n'
+        << "\t<cols>1</cols>" << '\n'
+        << "\t<dt>d</dt>" << '\n'
+        << "\t<data> 0. 0. 0. 0. 0. 0. 0. 0.</data>" << '\n'
+        << "</Distortion>" << '\n';
+
+    xml_file << "</opencv_storage>" << '\n';
     xml_file.close();
 }
 
+void Camera::updatePoseMatrices_() const
+{
+    view_matrix_ = glm::lookAt(position_, position_ + front_, up_);
+
+    // the view is rigid: the inverse is the transposed rotation & the camera position
+    glm::mat3 rotation = glm::transpose(glm::mat3(view_matrix_));
+    camera_to_world_matrix_ = glm::mat4(rotation);
+    camera_to_world_matrix_[3] = glm::vec4(position_, 1.0f);
+
+    // now rotate the whole final scene to match opencv coordinate system orientation 
+    glm::mat4 turn_y_180 = glm::mat4(1.0);
+    turn_y_180[0][0] = -1.0f;
+    turn_y_180[2][2] = -1.0f;
+    extrinsics_matrix_ = view_matrix_ * turn_y_180;
+
+    pose_dirty_ = false;
+}
+
+void Camera::updateIntrinsicsMatrices_() const
+{
+    projection_matrix_ = glm::perspective(glm::radians(field_of_view_y_), screen_width_ / screen_height_, near_plane_, far_plane_);
+
+    // principal point offset from the image center, in NDC. Image y goes down, GL y goes up
+    projection_matrix_[2][0] = 1.0f - 2.0f * principal_point_.x / screen_width_;
+    projection_matrix_[2][1] = 2.0f * principal_point_.y / screen_height_ - 1.0f;
+
+    intrinsics_matrix_ = glm::mat3(1.0f);  // identity
+    float pix_focal = screen_height_ / (2 * tan(glm::radians(field_of_view_y_) / 2));
+
+    // column-wise storage: mat[col][row]
+    intrinsics_matrix_[0][0] = pix_focal;
+    intrinsics_matrix_[1][1] = pix_focal;
+    intrinsics_matrix_[2][0] = principal_point_.x;
+    intrinsics_matrix_[2][1] = principal_point_.y;
+
+    intrinsics_dirty_ = false;
+}
+
 void Camera::updateVectorsByRotation_()
 {
     // New Front vector
@@ -237,6 +360,7 @@ void Camera::updateVectorsByRotation_()
     // re-calculate the Right and Up vector
     right_ = glm::normalize(glm::cross(front_, world_up_)); 
     up_ = glm::normalize(glm::cross(right_, front_));
+    invalidatePose_();
 }
 
 void Camera::updateFrontByTarget_()
@@ -246,4 +370,5 @@ void Camera::updateFrontByTarget_()
     // re-calculate the Right and Up vector
     right_ = glm::normalize(glm::cross(front_, world_up_));
     up_ = glm::normalize(glm::cross(right_, front_));
+    invalidatePose_();
 }
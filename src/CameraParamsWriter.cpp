@@ -0,0 +1,168 @@
+#include "../header/CameraParamsWriter.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+    // floats survive the round trip through the text
+    const int float_precision = 9;
+
+    void putRows(std::ostringstream& out, const float* values, int rows, int cols, const char* indent)
+    {
+        for (int i = 0; i < rows; ++i)
+        {
+            out << indent;
+            for (int j = 0; j < cols; ++j)
+            {
+                out << values[i * cols + j] << " ";
+            }
+            out << '\n';
+        }
+    }
+
+    void putYAMLMatrix(std::ostringstream& out, const char* name, const float* values, int rows, int cols)
+    {
+        out << "     " << name << ": !!opencv-matrix\n"
+            << "        rows: " << rows << "\n"
+            << "        cols: " << cols << "\n"
+            << "        dt: d\n"
+            << "        data: [ ";
+        for (int i = 0; i < rows * cols; ++i)
+        {
+            out << values[i] << (i + 1 < rows * cols ? ", " : " ]\n");
+        }
+    }
+}
+
+int CameraParamsWriter::writeOpenCVXML(const std::string& filename, const std::vector<Camera>& cameras)
+{
+    std::ostringstream out;
+    out.precision(float_precision);
+    out << "<?xml version=\"1.0\"?>\n"
+        << "<opencv_storage>\n"
+        << "<cameras>\n";
+
+    for (auto &&camera : cameras)
+    {
+        ArchiveCamera params = record(camera);
+        out << "  <_>\n"
+            << "    <id>" << params.camera_id << "</id>\n"
+            << "    <image_width>" << params.width << "</image_width>\n"
+            << "    <image_height>" << params.height << "</image_height>\n";
+
+        out << "    <CameraMatrix type_id=\"opencv-matrix\">\n"
+            << "      <rows>3</rows>\n"
+            << "      <cols>4</cols>\n"
+            << "      <dt>d</dt>\n"
+            << "      <data>\n";
+        putRows(out, params.extrinsics, 3, 4, "        ");
+        out << "      </data></CameraMatrix>\n";
+
+        out << "    <Intrinsics type_id=\"opencv-matrix\">\n"
+            << "      <rows>3</rows>\n"
+            << "      <cols>3</cols>\n"
+            << "      <dt>d</dt>\n"
+            << "      <data>\n";
+        putRows(out, params.intrinsics, 3, 3, "        ");
+        out << "      </data></Intrinsics>\n";
+
+        // No distortion
+        out << "    <Distortion type_id=\"opencv-matrix\">\n"
+            << "      <rows>8</rows>\n"
+            << "      <cols>1</cols>\n"
+            << "      <dt>d</dt>\n"
+            << "      <data> 0. 0. 0. 0. 0. 0. 0. 0.</data></Distortion>\n"
+            << "  </_>\n";
+    }
+
+    out << "</cameras>\n"
+        << "</opencv_storage>\n";
+
+    return writeFile_(filename, out.str());
+}
+
+int CameraParamsWriter::writeOpenCVYAML(const std::string& filename, const std::vector<Camera>& cameras)
+{
+    static const float no_distortion[8] = { 0 };
+
+    std::ostringstream out;
+    out.precision(float_precision);
+    out << "%YAML:1.0\n"
+        << "---\n"
+        << "cameras:\n";
+
+    for (auto &&camera : cameras)
+    {
+        ArchiveCamera params = record(camera);
+        out << "   - id: " << params.camera_id << "\n"
+            << "     image_width: " << params.width << "\n"
+            << "     image_height: " << params.height << "\n";
+        putYAMLMatrix(out, "CameraMatrix", params.extrinsics, 3, 4);
+        putYAMLMatrix(out, "Intrinsics", params.intrinsics, 3, 3);
+        putYAMLMatrix(out, "Distortion", no_distortion, 8, 1);
+    }
+
+    return writeFile_(filename, out.str());
+}
+
+int CameraParamsWriter::writeBinary(const std::string& filename, const std::vector<Camera>& cameras)
+{
+    unsigned int header[3] = { 0, 1, (unsigned int)cameras.size() };
+    std::memcpy(header, "PCAM", 4);
+
+    std::string content((const char*)header, sizeof(header));
+    content.reserve(sizeof(header) + cameras.size() * sizeof(ArchiveCamera));
+    for (auto &&camera : cameras)
+    {
+        ArchiveCamera params = record(camera);
+        content.append((const char*)&params, sizeof(params));
+    }
+
+    return writeFile_(filename, content);
+}
+
+ArchiveCamera CameraParamsWriter::record(const Camera& camera)
+{
+    const glm::mat4& extrinsics = camera.getCVExtrinsicsMatrix();
+    const glm::mat3& intrinsics = camera.getCVIntrinsicsMatrix();
+
+    ArchiveCamera params = {};
+    params.camera_id = camera.getID();
+    params.width = camera.getWidth();
+    params.height = camera.getHeight();
+    // row-major from the colwise storage
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            params.intrinsics[i * 3 + j] = intrinsics[j][i];
+        }
+        for (int j = 0; j < 4; ++j)
+        {
+            params.extrinsics[i * 4 + j] = extrinsics[j][i];
+        }
+    }
+    return params;
+}
+
+int CameraParamsWriter::writeFile_(const std::string& filename, const std::string& content)
+{
+    std::FILE* file = std::fopen(filename.c_str(), "wb");
+    if (file == nullptr)
+    {
+        std::cout << "ERROR::CAMERA PARAMS WRITER::Failed to open " << filename << ". Check that the path exists" << std::endl;
+        return 0;
+    }
+
+    bool success = std::fwrite(content.data(), 1, content.size(), file) == content.size();
+    success = std::fclose(file) == 0 && success;
+    if (!success)
+    {
+        std::cout << "ERROR::CAMERA PARAMS WRITER::Failed to write " << filename << std::endl;
+    }
+
+    return success;
+}
@@ -0,0 +1,144 @@
+#include "../header/CameraRig.h"
+
+CameraRig::Handle CameraRig::add(const Camera& camera)
+{
+    std::uint32_t slot;
+    if (!free_slots_.empty())
+    {
+        slot = free_slots_.back();
+        free_slots_.pop_back();
+    }
+    else
+    {
+        slot = (std::uint32_t)slot_indices_.size();
+        slot_indices_.push_back(0);
+        slot_generations_.push_back(0);
+    }
+    ++slot_generations_[slot];
+    slot_indices_[slot] = (std::uint32_t)cameras_.size();
+
+    cameras_.push_back(camera);
+    slots_.push_back(slot);
+    positions_.emplace_back();
+    view_directions_.emplace_back();
+    intrinsics_.emplace_back();
+    image_sizes_.emplace_back();
+    mirror_(cameras_.size() - 1);
+
+    return Handle{ slot, slot_generations_[slot] };
+}
+
+bool CameraRig::remove(Handle handle)
+{
+    if (!contains(handle))
+    {
+        return false;
+    }
+
+    std::size_t index = slot_indices_[handle.slot];
+    std::size_t last = cameras_.size() - 1;
+    if (index != last)
+    {
+        cameras_[index] = cameras_[last];
+        slots_[index] = slots_[last];
+        positions_[index] = positions_[last];
+        view_directions_[index] = view_directions_[last];
+        intrinsics_[index] = intrinsics_[last];
+        image_sizes_[index] = image_sizes_[last];
+        slot_indices_[slots_[index]] = (std::uint32_t)index;
+    }
+    cameras_.pop_back();
+    slots_.pop_back();
+    positions_.pop_back();
+    view_directions_.pop_back();
+    intrinsics_.pop_back();
+    image_sizes_.pop_back();
+
+    ++slot_generations_[handle.slot];
+    free_slots_.push_back(handle.slot);
+
+    return true;
+}
+
+void CameraRig::clear()
+{
+    for (auto &&slot : slots_)
+    {
+        ++slot_generations_[slot];
+        free_slots_.push_back(slot);
+    }
+    cameras_.clear();
+    slots_.clear();
+    positions_.clear();
+    view_directions_.clear();
+    intrinsics_.clear();
+    image_sizes_.clear();
+}
+
+void CameraRig::reserve(std::size_t n_cameras)
+{
+    cameras_.reserve(n_cameras);
+    slots_.reserve(n_cameras);
+    positions_.reserve(n_cameras);
+    view_directions_.reserve(n_cameras);
+    intrinsics_.reserve(n_cameras);
+    image_sizes_.reserve(n_cameras);
+}
+
+bool CameraRig::contains(Handle handle) const
+{
+    return handle.slot < slot_generations_.size()
+        && handle.generation == slot_generations_[handle.slot]
+        && (handle.generation & 1u);
+}
+
+std::size_t CameraRig::indexOf(Handle handle) const
+{
+    return contains(handle) ? slot_indices_[handle.slot] : cameras_.size();
+}
+
+CameraRig::Handle CameraRig::handleAt(std::size_t index) const
+{
+    std::uint32_t slot = slots_[index];
+    return Handle{ slot, slot_generations_[slot] };
+}
+
+const Camera* CameraRig::find(Handle handle) const
+{
+    return contains(handle) ? &cameras_[slot_indices_[handle.slot]] : nullptr;
+}
+
+void CameraRig::setPose(std::size_t index, glm::vec3 position, glm::vec3 target)
+{
+    cameras_[index].setPose(position, target);
+    mirror_(index);
+}
+
+void CameraRig::setResolution(std::size_t index, int width, int height)
+{
+    cameras_[index].setResolution(width, height);
+    mirror_(index);
+}
+
+void CameraRig::setPrincipalPoint(std::size_t index, float cx, float cy)
+{
+    cameras_[index].setPrincipalPoint(cx, cy);
+    mirror_(index);
+}
+
+void CameraRig::setClippingPlanes(std::size_t index, float near_plane, float far_plane)
+{
+    // not mirrored
+    cameras_[index].setClippingPlanes(near_plane, far_plane);
+}
+
+void CameraRig::mirror_(std::size_t index)
+{
+    const Camera& camera = cameras_[index];
+    const glm::mat3& intrinsics = camera.getCVIntrinsicsMatrix();
+
+    positions_[index] = camera.getPosition();
+    view_directions_[index] = camera.getFrontVector();
+    intrinsics_[index] = glm::vec4(intrinsics[0][0], intrinsics[1][1], intrinsics[2][0], intrinsics[2][1]);
+    image_sizes_[index] = glm::ivec2(camera.getWidth(), camera.getHeight());
+}
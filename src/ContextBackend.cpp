@@ -0,0 +1,376 @@
+#include "../header/ContextBackend.h"
+
+#include <cstdlib>
+#include <map>
+#include <mutex>
+
+#ifdef PHOTOGRAPHER_WITH_EGL
+#include <EGL/eglext.h>
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+#endif
+
+#ifdef PHOTOGRAPHER_WITH_OSMESA
+#include <GL/osmesa.h>
+#endif
+
+namespace
+{
+    // glad function pointers are global
+    std::mutex gl_loader_mutex;
+    GLADloadproc gl_loader = nullptr;
+    int n_gl_users = 0;
+
+    // glfwInit() & glfwTerminate() are for the whole process
+    std::mutex glfw_mutex;
+    int n_glfw_windows = 0;
+
+#ifdef PHOTOGRAPHER_WITH_EGL
+    // eglTerminate() would take the display from all the contexts on it
+    std::mutex egl_mutex;
+    std::map<EGLDisplay, int> egl_display_users;
+#endif
+}
+
+ContextBackend::~ContextBackend()
+{
+    if (gl_loaded_)
+    {
+        std::lock_guard<std::mutex> lock(gl_loader_mutex);
+        --n_gl_users;
+    }
+}
+
+bool ContextBackend::loadGL()
+{
+    if (gl_loaded_)
+    {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(gl_loader_mutex);
+    GLADloadproc loader = getProcLoader();
+    if (n_gl_users > 0 && loader != gl_loader)
+    {
+        std::cout << "ERROR::CONTEXT BACKEND::GL functions are loaded for another backend, which is still in use. "
+            << "Use the same backend for all the Photographers running at the same time" << std::endl;
+        return false;
+    }
+    if (n_gl_users == 0 && !gladLoadGLLoader(loader))
+    {
+        return false;
+    }
+
+    gl_loader = loader;
+    ++n_gl_users;
+    gl_loaded_ = true;
+    return true;
+}
+
+ContextBackend* ContextBackend::create(BackendTypes type)
+{
+    switch (type)
+    {
+    case BackendTypes::GLFW_BACKEND:
+        return new GLFWContextBackend();
+#ifdef PHOTOGRAPHER_WITH_EGL
+    case BackendTypes::EGL_BACKEND:
+        return new EGLContextBackend();
+#endif
+#ifdef PHOTOGRAPHER_WITH_OSMESA
+    case BackendTypes::OSMESA_BACKEND:
+        return new OSMesaContextBackend();
+#endif
+    default:
+        std::cout << "ERROR::CONTEXT BACKEND::Backend " << type << " is not compiled in. "
+            << "Define PHOTOGRAPHER_WITH_EGL or PHOTOGRAPHER_WITH_OSMESA to enable it" << std::endl;
+        return nullptr;
+    }
+}
+
+bool ContextBackend::isAvailable(BackendTypes type)
+{
+    switch (type)
+    {
+    case BackendTypes::GLFW_BACKEND:
+        return true;
+#ifdef PHOTOGRAPHER_WITH_EGL
+    case BackendTypes::EGL_BACKEND:
+        return true;
+#endif
+#ifdef PHOTOGRAPHER_WITH_OSMESA
+    case BackendTypes::OSMESA_BACKEND:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+ContextBackend::BackendTypes ContextBackend::typeFromEnvironment(BackendTypes fallback)
+{
+    const char* value = std::getenv("PHOTOGRAPHER_CONTEXT");
+    if (value == nullptr)
+    {
+        return fallback;
+    }
+
+    std::string name(value);
+    if (name == "glfw") return BackendTypes::GLFW_BACKEND;
+    if (name == "egl") return BackendTypes::EGL_BACKEND;
+    if (name == "osmesa") return BackendTypes::OSMESA_BACKEND;
+
+    std::cout << "WARNING::CONTEXT BACKEND::Unknown PHOTOGRAPHER_CONTEXT value " << name
+        << ". Expected glfw, egl or osmesa" << std::endl;
+    return fallback;
+}
+
+// ----------------- GLFW ------------------
+
+bool GLFWContextBackend::init(int width, int height, bool visible)
+{
+    // window hints are global as well
+    std::lock_guard<std::mutex> lock(glfw_mutex);
+    if (n_glfw_windows == 0 && !glfwInit())
+    {
+        std::cout << "Failed to initialize GLFW" << std::endl;
+        return false;
+    }
+    glfwDefaultWindowHints();
+
+    // Configure GLFW
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    if (!visible)
+    {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    }
+
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // uncomment this statement to fix compilation on OS X
+#endif
+
+    // create a window
+    window_ = glfwCreateWindow(width, height, "Photographer", NULL, NULL);
+    if (window_ == NULL)
+    {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        if (n_glfw_windows == 0)
+        {
+            glfwTerminate();
+        }
+        return false;
+    }
+    ++n_glfw_windows;
+    glfwMakeContextCurrent(window_);
+
+    return true;
+}
+
+void GLFWContextBackend::terminate()
+{
+    if (window_ == nullptr)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(glfw_mutex);
+    glfwDestroyWindow(window_);
+    window_ = nullptr;
+    if (--n_glfw_windows == 0)
+    {
+        glfwTerminate();
+    }
+}
+
+bool GLFWContextBackend::makeCurrent()
+{
+    if (window_ == nullptr)
+    {
+        return false;
+    }
+    glfwMakeContextCurrent(window_);
+    return true;
+}
+
+GLADloadproc GLFWContextBackend::getProcLoader()
+{
+    return (GLADloadproc)glfwGetProcAddress;
+}
+
+// ----------------- EGL ------------------
+
+#ifdef PHOTOGRAPHER_WITH_EGL
+bool EGLContextBackend::init(int width, int height, bool visible)
+{
+    if (visible)
+    {
+        std::cout << "WARNING::EGL CONTEXT::EGL backend is headless. Nothing will be shown" << std::endl;
+    }
+
+    // surfaceless platform doesn't need any display server or GPU device
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display != nullptr)
+    {
+        display_ = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    }
+    if (display_ == EGL_NO_DISPLAY)
+    {
+        display_ = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+
+    EGLint major, minor;
+    {
+        std::lock_guard<std::mutex> lock(egl_mutex);
+        if (display_ == EGL_NO_DISPLAY || !eglInitialize(display_, &major, &minor))
+        {
+            std::cout << "Failed to initialize EGL display" << std::endl;
+            display_ = EGL_NO_DISPLAY;
+            return false;
+        }
+        ++egl_display_users[display_];
+    }
+
+    // no surface will be created -- any config would do
+    const EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint n_configs = 0;
+    if (!eglChooseConfig(display_, config_attribs, &config, 1, &n_configs) || n_configs < 1)
+    {
+        // EGL_KHR_no_config_context
+        config = (EGLConfig)0;
+    }
+
+    eglBindAPI(EGL_OPENGL_API);
+
+    const EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    context_ = eglCreateContext(display_, config, EGL_NO_CONTEXT, context_attribs);
+    if (context_ == EGL_NO_CONTEXT)
+    {
+        std::cout << "Failed to create EGL context" << std::endl;
+        terminate();
+        return false;
+    }
+
+    if (!eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, context_))
+    {
+        std::cout << "Failed to make EGL context current. EGL_KHR_surfaceless_context is required" << std::endl;
+        terminate();
+        return false;
+    }
+
+    return true;
+}
+
+void EGLContextBackend::terminate()
+{
+    if (display_ == EGL_NO_DISPLAY)
+    {
+        return;
+    }
+
+    eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context_ != EGL_NO_CONTEXT)
+    {
+        eglDestroyContext(display_, context_);
+        context_ = EGL_NO_CONTEXT;
+    }
+
+    // the display is the same for all the contexts of the process
+    std::lock_guard<std::mutex> lock(egl_mutex);
+    if (--egl_display_users[display_] == 0)
+    {
+        egl_display_users.erase(display_);
+        eglTerminate(display_);
+    }
+    display_ = EGL_NO_DISPLAY;
+}
+
+bool EGLContextBackend::makeCurrent()
+{
+    return context_ != EGL_NO_CONTEXT && eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, context_);
+}
+
+GLADloadproc EGLContextBackend::getProcLoader()
+{
+    return (GLADloadproc)eglGetProcAddress;
+}
+#endif
+
+// ----------------- OSMesa ------------------
+
+#ifdef PHOTOGRAPHER_WITH_OSMESA
+bool OSMesaContextBackend::init(int width, int height, bool visible)
+{
+    if (visible)
+    {
+        std::cout << "WARNING::OSMESA CONTEXT::OSMesa backend is headless. Nothing will be shown" << std::endl;
+    }
+
+    const int attribs[] = {
+        OSMESA_FORMAT, OSMESA_RGBA,
+        OSMESA_DEPTH_BITS, 24,
+        OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+        OSMESA_CONTEXT_MAJOR_VERSION, 3,
+        OSMESA_CONTEXT_MINOR_VERSION, 3,
+        0
+    };
+    context_ = OSMesaCreateContextAttribs(attribs, NULL);
+    if (context_ == nullptr)
+    {
+        std::cout << "Failed to create OSMesa context" << std::endl;
+        return false;
+    }
+
+    default_buffer_.resize((std::size_t)width * height * 4);
+    width_ = width;
+    height_ = height;
+    if (!makeCurrent())
+    {
+        std::cout << "Failed to make OSMesa context current" << std::endl;
+        terminate();
+        return false;
+    }
+
+    return true;
+}
+
+void OSMesaContextBackend::terminate()
+{
+    if (context_ != nullptr)
+    {
+        OSMesaDestroyContext(context_);
+        context_ = nullptr;
+    }
+    default_buffer_.clear();
+    default_buffer_.shrink_to_fit();
+}
+
+bool OSMesaContextBackend::makeCurrent()
+{
+    return context_ != nullptr && OSMesaMakeCurrent(context_, default_buffer_.data(), GL_UNSIGNED_BYTE, width_, height_);
+}
+
+GLADloadproc OSMesaContextBackend::getProcLoader()
+{
+    return OSMesaContextBackend::getProcAddress_;
+}
+
+void* OSMesaContextBackend::getProcAddress_(const char* name)
+{
+    return (void*)OSMesaGetProcAddress(name);
+}
+#endif
@@ -0,0 +1,218 @@
+#include "../header/DatasetWriter.h"
+
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+    const char* const transforms_tail = "\n  ]\n}\n";
+
+    // w, x, y, z of the rotation part of the row-major 3x4 [R|t]
+    void rotationToQuaternion(const float* rt, double q[4])
+    {
+        double r00 = rt[0], r01 = rt[1], r02 = rt[2];
+        double r10 = rt[4], r11 = rt[5], r12 = rt[6];
+        double r20 = rt[8], r21 = rt[9], r22 = rt[10];
+        double trace = r00 + r11 + r22;
+        if (trace > 0.0)
+        {
+            double s = 0.5 / std::sqrt(trace + 1.0);
+            q[0] = 0.25 / s;
+            q[1] = (r21 - r12) * s;
+            q[2] = (r02 - r20) * s;
+            q[3] = (r10 - r01) * s;
+        }
+        else if (r00 > r11 && r00 > r22)
+        {
+            double s = 2.0 * std::sqrt(1.0 + r00 - r11 - r22);
+            q[0] = (r21 - r12) / s;
+            q[1] = 0.25 * s;
+            q[2] = (r01 + r10) / s;
+            q[3] = (r02 + r20) / s;
+        }
+        else if (r11 > r22)
+        {
+            double s = 2.0 * std::sqrt(1.0 + r11 - r00 - r22);
+            q[0] = (r02 - r20) / s;
+            q[1] = (r01 + r10) / s;
+            q[2] = 0.25 * s;
+            q[3] = (r12 + r21) / s;
+        }
+        else
+        {
+            double s = 2.0 * std::sqrt(1.0 + r22 - r00 - r11);
+            q[0] = (r10 - r01) / s;
+            q[1] = (r02 + r20) / s;
+            q[2] = (r12 + r21) / s;
+            q[3] = 0.25 * s;
+        }
+        // COLMAP keeps qw non-negative
+        if (q[0] < 0.0)
+        {
+            for (int i = 0; i < 4; ++i)
+            {
+                q[i] = -q[i];
+            }
+        }
+    }
+
+    bool writeAndFlush(std::FILE* file, const std::string& text)
+    {
+        return std::fwrite(text.data(), 1, text.size(), file) == text.size() && std::fflush(file) == 0;
+    }
+}
+
+DatasetWriter::~DatasetWriter()
+{
+    close();
+}
+
+bool DatasetWriter::open(const std::string& path, Formats formats)
+{
+    close();
+
+    bool success = true;
+    if (formats & NERF)
+    {
+        std::string filename = path + "/transforms.json";
+        transforms_ = std::fopen(filename.c_str(), "wb");
+        success = transforms_ != nullptr && writeAndFlush(transforms_, "{\n  \"frames\": [");
+        if (success)
+        {
+            transforms_end_ = std::ftell(transforms_);
+            success = writeAndFlush(transforms_, transforms_tail);
+        }
+        if (!success)
+        {
+            std::cout << "ERROR::DATASET WRITER::Failed to start " << filename << ". Check that the path exists" << std::endl;
+        }
+        n_transforms_ = 0;
+    }
+    if (success && (formats & COLMAP))
+    {
+        std::string model_path = path + "/sparse/0/";
+        colmap_cameras_ = std::fopen((model_path + "cameras.txt").c_str(), "wb");
+        colmap_images_ = std::fopen((model_path + "images.txt").c_str(), "wb");
+        std::FILE* points = std::fopen((model_path + "points3D.txt").c_str(), "wb");
+        success = colmap_cameras_ != nullptr && colmap_images_ != nullptr && points != nullptr
+            && writeAndFlush(colmap_cameras_, "# Camera list with one line of data per camera:\n"
+                "#   CAMERA_ID, MODEL, WIDTH, HEIGHT, PARAMS[]\n")
+            && writeAndFlush(colmap_images_, "# Image list with two lines of data per image:\n"
+                "#   IMAGE_ID, QW, QX, QY, QZ, TX, TY, TZ, CAMERA_ID, NAME\n"
+                "#   POINTS2D[] as (X, Y, POINT3D_ID)\n")
+            && writeAndFlush(points, "# 3D point list is empty: poses are known, no points are reconstructed\n");
+        if (points != nullptr)
+        {
+            success = std::fclose(points) == 0 && success;
+        }
+        if (!success)
+        {
+            std::cout << "ERROR::DATASET WRITER::Failed to start the COLMAP model in " << model_path
+                << ". Check that the path exists" << std::endl;
+        }
+    }
+
+    if (!success)
+    {
+        close();
+    }
+    return success;
+}
+
+int DatasetWriter::addView(const View& view)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    bool success = true;
+    if (transforms_ != nullptr)
+    {
+        success = appendNeRF_(view);
+    }
+    if (colmap_images_ != nullptr)
+    {
+        success = appendCOLMAP_(view) && success;
+    }
+    if (!success)
+    {
+        std::cout << "ERROR::DATASET WRITER::Failed to add the pose of camera " << view.params.camera_id << std::endl;
+    }
+
+    return success;
+}
+
+void DatasetWriter::close()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (std::FILE** file : { &transforms_, &colmap_cameras_, &colmap_images_ })
+    {
+        if (*file != nullptr)
+        {
+            std::fclose(*file);
+            *file = nullptr;
+        }
+    }
+}
+
+bool DatasetWriter::appendNeRF_(const View& view)
+{
+    const ArchiveCamera& params = view.params;
+    std::ostringstream record;
+    record.precision(9);
+    record << (n_transforms_ > 0 ? ",\n" : "\n")
+        << "    {\n"
+        << "      \"file_path\": \"" << view.image_name << "\",\n"
+        << "      \"transform_matrix\": [";
+    for (int i = 0; i < 4; ++i)
+    {
+        record << (i > 0 ? ", [" : "[");
+        for (int j = 0; j < 4; ++j)
+        {
+            record << view.transform[i * 4 + j] << (j < 3 ? ", " : "]");
+        }
+    }
+    record << "],\n"
+        // intrinsics are per camera -- the model goes next to them
+        << "      \"camera_model\": \"OPENCV\", \"fl_x\": " << params.intrinsics[0] << ", \"fl_y\": " << params.intrinsics[4]
+        << ", \"cx\": " << params.intrinsics[2] << ", \"cy\": " << params.intrinsics[5]
+        << ", \"w\": " << params.width << ", \"h\": " << params.height;
+    if (!view.depth_name.empty())
+    {
+        record << ",\n      \"depth_file_path\": \"" << view.depth_name << "\"";
+    }
+    if (!view.mask_name.empty())
+    {
+        record << ",\n      \"mask_path\": \"" << view.mask_name << "\"";
+    }
+    record << "\n    }";
+
+    // the record replaces the closing brackets, which are written again after it
+    if (std::fseek(transforms_, transforms_end_, SEEK_SET) != 0 || !writeAndFlush(transforms_, record.str()))
+    {
+        return false;
+    }
+    transforms_end_ = std::ftell(transforms_);
+    ++n_transforms_;
+
+    return writeAndFlush(transforms_, transforms_tail);
+}
+
+bool DatasetWriter::appendCOLMAP_(const View& view)
+{
+    const ArchiveCamera& params = view.params;
+    std::ostringstream camera;
+    camera.precision(9);
+    camera << params.camera_id << " PINHOLE " << params.width << " " << params.height << " "
+        << params.intrinsics[0] << " " << params.intrinsics[4] << " "
+        << params.intrinsics[2] << " " << params.intrinsics[5] << "\n";
+
+    double q[4];
+    rotationToQuaternion(params.extrinsics, q);
+    std::ostringstream image;
+    image.precision(9);
+    image << params.camera_id << " " << q[0] << " " << q[1] << " " << q[2] << " " << q[3] << " "
+        << params.extrinsics[3] << " " << params.extrinsics[7] << " " << params.extrinsics[11] << " "
+        << params.camera_id << " " << view.image_name.substr(view.image_name.find('/') + 1) << "\n\n";
+
+    return writeAndFlush(colmap_cameras_, camera.str()) && writeAndFlush(colmap_images_, image.str());
+}
@@ -0,0 +1,374 @@
+#include "../header/FrameArchive.h"
+
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// records are written as they are in memory
+static_assert(sizeof(ArchiveEntry) == 40, "ArchiveEntry should be packed into 40 bytes");
+static_assert(sizeof(ArchiveCamera) == 100, "ArchiveCamera should be packed into 100 bytes");
+
+namespace
+{
+    struct ArchiveHeader
+    {
+        char magic[4];
+        unsigned int version;
+        unsigned long long index_offset;
+        unsigned long long n_entries;
+        unsigned long long cameras_offset;
+        unsigned long long n_cameras;
+        unsigned char reserved[FrameArchiveWriter::header_size - 40];
+    };
+    static_assert(sizeof(ArchiveHeader) == FrameArchiveWriter::header_size, "Archive header should take 64 bytes");
+}
+
+FrameArchiveWriter::~FrameArchiveWriter()
+{
+    if (file_ != nullptr)
+    {
+        std::cout << "WARNING::FRAME ARCHIVE::" << filename_ << " is closed without the index" << std::endl;
+        std::fclose(file_);
+    }
+}
+
+bool FrameArchiveWriter::open(const std::string& filename)
+{
+    file_ = std::fopen(filename.c_str(), "wb");
+    if (file_ == nullptr)
+    {
+        std::cout << "ERROR::FRAME ARCHIVE::Failed to open " << filename << ". Check that the path exists" << std::endl;
+        return false;
+    }
+    filename_ = filename;
+    entries_.clear();
+    cameras_.clear();
+    failed_ = false;
+
+    // placeholder: completed by finish()
+    ArchiveHeader header = {};
+    std::memcpy(header.magic, "PFAR", 4);
+    header.version = 1;
+    position_ = 0;
+    failed_ = !writeAligned_(&header, sizeof(header));
+
+    return !failed_;
+}
+
+int FrameArchiveWriter::addFrame(const Frame& frame)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (file_ == nullptr)
+    {
+        return 0;
+    }
+
+    bool success = addImage_(frame.view, ArchiveEntry::COLOR);
+    if (frame.depth.data != nullptr)
+    {
+        success = addImage_(frame.depth, ArchiveEntry::DEPTH) && success;
+    }
+    if (frame.face_idx.data != nullptr)
+    {
+        success = addImage_(frame.face_idx, ArchiveEntry::FACE_IDX) && success;
+    }
+    if (!success)
+    {
+        std::cout << "ERROR::FRAME ARCHIVE::Failed to write camera " << frame.view.camera_id
+            << " to " << filename_ << std::endl;
+        failed_ = true;
+    }
+
+    return success;
+}
+
+void FrameArchiveWriter::addCamera(const ArchiveCamera& camera)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    cameras_.push_back(camera);
+}
+
+bool FrameArchiveWriter::finish()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (file_ == nullptr)
+    {
+        return false;
+    }
+
+    ArchiveHeader header = {};
+    std::memcpy(header.magic, "PFAR", 4);
+    header.version = 1;
+    header.cameras_offset = position_;
+    header.n_cameras = cameras_.size();
+    bool success = cameras_.empty() || writeAligned_(cameras_.data(), cameras_.size() * sizeof(ArchiveCamera));
+    header.index_offset = position_;
+    header.n_entries = entries_.size();
+    success = success && (entries_.empty() || writeAligned_(entries_.data(), entries_.size() * sizeof(ArchiveEntry)));
+
+    // the archive is valid only once the header points to the index
+    success = success && std::fseek(file_, 0, SEEK_SET) == 0
+        && std::fwrite(&header, sizeof(header), 1, file_) == 1;
+    success = std::fclose(file_) == 0 && success;
+    file_ = nullptr;
+    if (!success)
+    {
+        std::cout << "ERROR::FRAME ARCHIVE::Failed to write the index of " << filename_ << std::endl;
+    }
+
+    return success && !failed_;
+}
+
+bool FrameArchiveWriter::addImage_(const ImageView& view, unsigned int kind)
+{
+    ArchiveEntry entry = {};
+    entry.camera_id = view.camera_id;
+    entry.kind = kind;
+    entry.width = view.width;
+    entry.height = view.height;
+    entry.channels = view.channels;
+    entry.bytes_per_channel = view.bytes_per_channel;
+    entry.offset = position_;
+
+    // rows are packed tightly -- the views might be the tiles of an atlas
+    std::size_t row_size = (std::size_t)view.width * view.channels * view.bytes_per_channel;
+    entry.size = row_size * view.height;
+    if ((std::size_t)view.stride == row_size)
+    {
+        if (!writeAligned_(view.data, entry.size))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        for (int y = 0; y < view.height; ++y)
+        {
+            if (std::fwrite(view.row(y), 1, row_size, file_) != row_size)
+            {
+                return false;
+            }
+            position_ += row_size;
+        }
+        if (!writeAligned_(nullptr, 0))
+        {
+            return false;
+        }
+    }
+
+    entries_.push_back(entry);
+    return true;
+}
+
+bool FrameArchiveWriter::writeAligned_(const void* data, std::size_t size)
+{
+    static const unsigned char zeros[alignment] = { 0 };
+
+    if (size > 0 && std::fwrite(data, 1, size, file_) != size)
+    {
+        return false;
+    }
+    position_ += size;
+
+    std::size_t padding = (alignment - position_ % alignment) % alignment;
+    if (padding > 0 && std::fwrite(zeros, 1, padding, file_) != padding)
+    {
+        return false;
+    }
+    position_ += padding;
+
+    return true;
+}
+
+FrameArchiveReader::~FrameArchiveReader()
+{
+    close();
+}
+
+bool FrameArchiveReader::open(const std::string& filename)
+{
+    close();
+    if (!map_(filename))
+    {
+        std::cout << "ERROR::FRAME ARCHIVE::Failed to map " << filename << std::endl;
+        return false;
+    }
+
+    ArchiveHeader header;
+    if (size_ < sizeof(header))
+    {
+        std::cout << "ERROR::FRAME ARCHIVE::" << filename << " is too small to be an archive" << std::endl;
+        close();
+        return false;
+    }
+    std::memcpy(&header, data_, sizeof(header));
+    if (std::memcmp(header.magic, "PFAR", 4) != 0 || header.version != 1)
+    {
+        std::cout << "ERROR::FRAME ARCHIVE::" << filename << " is not a frame archive of version 1" << std::endl;
+        close();
+        return false;
+    }
+    if (header.index_offset == 0
+        || header.cameras_offset + header.n_cameras * sizeof(ArchiveCamera) > size_
+        || header.index_offset + header.n_entries * sizeof(ArchiveEntry) > size_)
+    {
+        std::cout << "ERROR::FRAME ARCHIVE::" << filename << " is incomplete: the writing has not finished" << std::endl;
+        close();
+        return false;
+    }
+
+    // the tables are small -- copied, so the records are always aligned
+    cameras_.resize((std::size_t)header.n_cameras);
+    if (!cameras_.empty())
+    {
+        std::memcpy(cameras_.data(), data_ + header.cameras_offset, cameras_.size() * sizeof(ArchiveCamera));
+    }
+    entries_.resize((std::size_t)header.n_entries);
+    if (!entries_.empty())
+    {
+        std::memcpy(entries_.data(), data_ + header.index_offset, entries_.size() * sizeof(ArchiveEntry));
+    }
+    for (auto &&entry : entries_)
+    {
+        if (entry.offset + entry.size > size_)
+        {
+            std::cout << "ERROR::FRAME ARCHIVE::Entry of camera " << entry.camera_id
+                << " is out of the bounds of " << filename << std::endl;
+            close();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void FrameArchiveReader::close()
+{
+    unmap_();
+    entries_.clear();
+    cameras_.clear();
+}
+
+const ArchiveEntry* FrameArchiveReader::find(unsigned int camera_id, ArchiveEntry::Kinds kind) const
+{
+    for (auto &&entry : entries_)
+    {
+        if (entry.camera_id == camera_id && entry.kind == (unsigned int)kind)
+        {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+ImageView FrameArchiveReader::view(const ArchiveEntry& entry) const
+{
+    ImageView view;
+    view.data = data_ + entry.offset;
+    view.width = entry.width;
+    view.height = entry.height;
+    view.channels = entry.channels;
+    view.bytes_per_channel = entry.bytes_per_channel;
+    view.stride = entry.width * entry.channels * entry.bytes_per_channel;
+    view.camera_id = entry.camera_id;
+    return view;
+}
+
+#ifdef _WIN32
+
+bool FrameArchiveReader::map_(const std::string& filename)
+{
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == NULL)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    file_handle_ = file;
+    mapping_handle_ = mapping;
+    data_ = (const unsigned char*)data;
+    size_ = (std::size_t)size.QuadPart;
+    return true;
+}
+
+void FrameArchiveReader::unmap_()
+{
+    if (data_ != nullptr)
+    {
+        UnmapViewOfFile(data_);
+        CloseHandle(mapping_handle_);
+        CloseHandle(file_handle_);
+        mapping_handle_ = file_handle_ = nullptr;
+    }
+    data_ = nullptr;
+    size_ = 0;
+}
+
+#else
+
+bool FrameArchiveReader::map_(const std::string& filename)
+{
+    int file = ::open(filename.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        return false;
+    }
+    struct stat file_stat;
+    if (fstat(file, &file_stat) != 0 || file_stat.st_size == 0)
+    {
+        ::close(file);
+        return false;
+    }
+    // the mapping keeps the file referenced
+    void* data = mmap(nullptr, (std::size_t)file_stat.st_size, PROT_READ, MAP_SHARED, file, 0);
+    ::close(file);
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    data_ = (const unsigned char*)data;
+    size_ = (std::size_t)file_stat.st_size;
+    return true;
+}
+
+void FrameArchiveReader::unmap_()
+{
+    if (data_ != nullptr)
+    {
+        munmap((void*)data_, size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+}
+
+#endif
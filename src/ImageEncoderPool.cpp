@@ -0,0 +1,124 @@
+#include "../header/ImageEncoderPool.h"
+
+ImageEncoderPool::ImageEncoderPool(std::size_t n_threads, std::size_t queue_capacity)
+    : buffers_(std::make_shared<BufferStorage>()), queue_capacity_(queue_capacity > 0 ? queue_capacity : 1)
+{
+    if (n_threads == 0) n_threads = 1;
+
+    workers_.reserve(n_threads);
+    for (std::size_t i = 0; i < n_threads; ++i)
+    {
+        workers_.emplace_back(&ImageEncoderPool::workerLoop_, this);
+    }
+}
+
+ImageEncoderPool::~ImageEncoderPool()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    queue_not_empty_.notify_all();
+
+    // workers finish the queue before exiting
+    for (auto &&worker : workers_)
+    {
+        worker.join();
+    }
+}
+
+ImageEncoderPool::PixelBuffer ImageEncoderPool::acquireBuffer(std::size_t size)
+{
+    std::vector<unsigned char>* buffer = nullptr;
+    {
+        std::unique_lock<std::mutex> lock(buffers_->mutex);
+        if (!buffers_->free_buffers.empty())
+        {
+            buffer = buffers_->free_buffers.back();
+            buffers_->free_buffers.pop_back();
+        }
+    }
+    if (buffer == nullptr)
+    {
+        buffer = new std::vector<unsigned char>;
+    }
+    buffer->resize(size);   // no reallocation after the first few frames
+
+    std::shared_ptr<BufferStorage> storage = buffers_;
+    return PixelBuffer(buffer, [storage](std::vector<unsigned char>* released)
+    {
+        std::unique_lock<std::mutex> lock(storage->mutex);
+        storage->free_buffers.push_back(released);
+    });
+}
+
+std::size_t ImageEncoderPool::submit(EncodeTask task)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    queue_not_full_.wait(lock, [this] { return queue_.size() < queue_capacity_; });
+
+    std::size_t ticket = results_.size();
+    results_.push_back(0);
+    queue_.push(Job{ ticket, std::move(task) });
+
+    lock.unlock();
+    queue_not_empty_.notify_one();
+
+    return ticket;
+}
+
+std::vector<int> ImageEncoderPool::finish()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    all_done_.wait(lock, [this] { return queue_.empty() && tasks_in_progress_ == 0; });
+
+    std::vector<int> results;
+    results.swap(results_);
+    return results;
+}
+
+std::size_t ImageEncoderPool::defaultThreadsNumber()
+{
+    // leave one core to the GL thread
+    unsigned int cores = std::thread::hardware_concurrency();
+    return cores > 1 ? cores - 1 : 1;
+}
+
+void ImageEncoderPool::workerLoop_()
+{
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            queue_not_empty_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+            if (queue_.empty())
+            {
+                return;     // stopped and nothing left to do
+            }
+
+            job = std::move(queue_.front());
+            queue_.pop();
+            ++tasks_in_progress_;
+        }
+        queue_not_full_.notify_one();
+
+        int success = job.task();
+        job.task = nullptr;     // release the pixel buffers as soon as possible
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            results_[job.ticket] = success;
+            --tasks_in_progress_;
+        }
+        all_done_.notify_all();
+    }
+}
+
+ImageEncoderPool::BufferStorage::~BufferStorage()
+{
+    for (auto &&buffer : free_buffers)
+    {
+        delete buffer;
+    }
+}
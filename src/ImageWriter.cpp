@@ -0,0 +1,519 @@
+#include "../header/ImageWriter.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <stb/stb_image_write.h>
+
+// zlib compressor of stb_image_write: public, but not declared in the header
+extern "C" unsigned char* stbi_zlib_compress(unsigned char* data, int data_len, int* out_len, int quality);
+
+namespace
+{
+    void putBigEndian32(std::vector<unsigned char>& out, unsigned int value)
+    {
+        out.push_back((value >> 24) & 0xFF);
+        out.push_back((value >> 16) & 0xFF);
+        out.push_back((value >> 8) & 0xFF);
+        out.push_back(value & 0xFF);
+    }
+
+    unsigned char paeth(int a, int b, int c)
+    {
+        int p = a + b - c;
+        int pa = std::abs(p - a);
+        int pb = std::abs(p - b);
+        int pc = std::abs(p - c);
+        return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+    }
+
+    // PNG filter type of the row; prior is nullptr for the first row
+    void filterRow(int filter, const unsigned char* row, const unsigned char* prior, int bytes_per_pixel,
+        std::size_t row_size, unsigned char* out)
+    {
+        for (std::size_t i = 0; i < row_size; ++i)
+        {
+            int a = i >= (std::size_t)bytes_per_pixel ? row[i - bytes_per_pixel] : 0;
+            int b = prior != nullptr ? prior[i] : 0;
+            int c = prior != nullptr && i >= (std::size_t)bytes_per_pixel ? prior[i - bytes_per_pixel] : 0;
+            switch (filter)
+            {
+            case 1: out[i] = row[i] - a; break;
+            case 2: out[i] = row[i] - b; break;
+            case 3: out[i] = row[i] - ((a + b) >> 1); break;
+            case 4: out[i] = row[i] - paeth(a, b, c); break;
+            default: out[i] = row[i];
+            }
+        }
+    }
+}
+
+int ImageWriter::writePNG(const std::string& filename, int width, int height, int channels,
+    const unsigned char* data, int stride, int compression_level)
+{
+    if (compression_level <= 0)
+    {
+        return writeUncompressedPNG(filename, width, height, channels, data, stride);
+    }
+    int color_type = channels == 1 ? 0 : channels == 3 ? 2 : channels == 4 ? 6 : -1;
+    if (color_type < 0)
+    {
+        std::cout << "ERROR::IMAGE WRITER::PNG can't hold " << channels << " channels: " << filename << std::endl;
+        return 0;
+    }
+
+    // every row gets the filter with the smallest sum of the residuals, as in stb
+    std::size_t row_size = (std::size_t)width * channels;
+    std::vector<unsigned char> scanlines((row_size + 1) * height);
+    std::vector<unsigned char> filtered(row_size);
+    for (int y = 0; y < height; ++y)
+    {
+        const unsigned char* row = data + (std::size_t)(height - 1 - y) * stride;
+        const unsigned char* prior = y > 0 ? row + stride : nullptr;
+        unsigned char* line = &scanlines[(row_size + 1) * y];
+        long long best_sum = -1;
+        for (int filter = 0; filter < 5; ++filter)
+        {
+            filterRow(filter, row, prior, channels, row_size, filtered.data());
+            long long sum = 0;
+            for (std::size_t i = 0; i < row_size; ++i)
+            {
+                sum += std::abs((int)(signed char)filtered[i]);
+            }
+            if (best_sum < 0 || sum < best_sum)
+            {
+                best_sum = sum;
+                line[0] = filter;
+                std::memcpy(line + 1, filtered.data(), row_size);
+            }
+        }
+    }
+
+    return writePNG_(filename, width, height, 8, color_type, scanlines, compression_level);
+}
+
+int ImageWriter::writePNG16(const std::string& filename, int width, int height, const unsigned short* data, int stride,
+    int compression_level)
+{
+    // scanlines of big-endian samples, each with "Sub" filter -- depth changes slowly along the row
+    const int bytes_per_pixel = 2;
+    std::size_t row_size = (std::size_t)width * bytes_per_pixel;
+    std::vector<unsigned char> scanlines((row_size + 1) * height);
+    for (int y = 0; y < height; ++y)
+    {
+        const unsigned short* row = (const unsigned short*)((const unsigned char*)data + (std::size_t)(height - 1 - y) * stride);
+        unsigned char* line = &scanlines[(row_size + 1) * y];
+        line[0] = 1;    // Sub
+        unsigned char* raw = line + 1;
+        for (int x = 0; x < width; ++x)
+        {
+            raw[2 * x] = row[x] >> 8;
+            raw[2 * x + 1] = row[x] & 0xFF;
+        }
+        for (std::size_t i = row_size; i-- > bytes_per_pixel; )
+        {
+            raw[i] -= raw[i - bytes_per_pixel];
+        }
+    }
+
+    return writePNG_(filename, width, height, 16, 0, scanlines, compression_level);    // grayscale
+}
+
+int ImageWriter::writeUncompressedPNG(const std::string& filename, int width, int height, int channels,
+    const unsigned char* data, int stride)
+{
+    int color_type = channels == 1 ? 0 : channels == 3 ? 2 : channels == 4 ? 6 : -1;
+    if (color_type < 0)
+    {
+        std::cout << "ERROR::IMAGE WRITER::PNG can't hold " << channels << " channels: " << filename << std::endl;
+        return 0;
+    }
+
+    // scanlines with "None" filter
+    std::size_t row_size = (std::size_t)width * channels;
+    std::vector<unsigned char> scanlines((row_size + 1) * height);
+    for (int y = 0; y < height; ++y)
+    {
+        unsigned char* line = &scanlines[(row_size + 1) * y];
+        line[0] = 0;
+        std::memcpy(line + 1, data + (std::size_t)(height - 1 - y) * stride, row_size);
+    }
+
+    return writePNG_(filename, width, height, 8, color_type, scanlines, 0);
+}
+
+int ImageWriter::writePNM(const std::string& filename, int width, int height, int channels, const unsigned char* data, int stride)
+{
+    if (channels != 1 && channels != 3)
+    {
+        std::cout << "ERROR::IMAGE WRITER::PNM can't hold " << channels << " channels: " << filename << std::endl;
+        return 0;
+    }
+    std::string header = std::string(channels == 1 ? "P5" : "P6") + "\n" 
+        + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+
+    return writeFile_(filename, header.data(), header.size(), height, data, width * channels, stride);
+}
+
+int ImageWriter::writePGM16(const std::string& filename, int width, int height, const unsigned short* data, int stride)
+{
+    std::vector<unsigned short> big_endian((std::size_t)width * height);
+    for (int y = 0; y < height; ++y)
+    {
+        const unsigned short* row = (const unsigned short*)((const unsigned char*)data + (std::size_t)y * stride);
+        unsigned short* out = &big_endian[(std::size_t)y * width];
+        for (int x = 0; x < width; ++x)
+        {
+            unsigned char bytes[2] = { (unsigned char)(row[x] >> 8), (unsigned char)(row[x] & 0xFF) };
+            std::memcpy(&out[x], bytes, 2);
+        }
+    }
+    std::string header = "P5\n" + std::to_string(width) + " " + std::to_string(height) + "\n65535\n";
+
+    return writeFile_(filename, header.data(), header.size(), height, (const unsigned char*)big_endian.data(), 
+        width * sizeof(unsigned short), width * sizeof(unsigned short));
+}
+
+int ImageWriter::writeQOI(const std::string& filename, int width, int height, int channels, const unsigned char* data, int stride)
+{
+    if (channels != 3 && channels != 4)
+    {
+        std::cout << "ERROR::IMAGE WRITER::QOI can't hold " << channels << " channels: " << filename << std::endl;
+        return 0;
+    }
+
+    // worst case: a tag byte per channel + alpha for every pixel
+    std::size_t n_pixels = (std::size_t)width * height;
+    std::vector<unsigned char> qoi;
+    qoi.reserve(14 + n_pixels * (channels + 1) + 8);
+    qoi.insert(qoi.end(), { 'q', 'o', 'i', 'f' });
+    putBigEndian32(qoi, width);
+    putBigEndian32(qoi, height);
+    qoi.push_back((unsigned char)channels);
+    qoi.push_back(0);   // sRGB with linear alpha
+
+    // encoder of the specification: runs, index of the recent colors, small diffs, then full pixels
+    struct Pixel { unsigned char r, g, b, a; };
+    Pixel index[64] = {};
+    Pixel prev = { 0, 0, 0, 255 };
+    int run = 0;
+    for (int y = height - 1; y >= 0; --y)
+    {
+        const unsigned char* row = data + (std::size_t)y * stride;
+        for (int x = 0; x < width; ++x)
+        {
+            const unsigned char* p = row + (std::size_t)x * channels;
+            Pixel px = { p[0], p[1], p[2], channels == 4 ? p[3] : (unsigned char)255 };
+            bool same = px.r == prev.r && px.g == prev.g && px.b == prev.b && px.a == prev.a;
+            if (same)
+            {
+                if (++run == 62)
+                {
+                    qoi.push_back(0xC0 | (run - 1));
+                    run = 0;
+                }
+                continue;
+            }
+            if (run > 0)
+            {
+                qoi.push_back(0xC0 | (run - 1));
+                run = 0;
+            }
+
+            int hash = (px.r * 3 + px.g * 5 + px.b * 7 + px.a * 11) % 64;
+            Pixel& cached = index[hash];
+            if (cached.r == px.r && cached.g == px.g && cached.b == px.b && cached.a == px.a)
+            {
+                qoi.push_back((unsigned char)hash);
+            }
+            else if (px.a != prev.a)
+            {
+                qoi.insert(qoi.end(), { 0xFF, px.r, px.g, px.b, px.a });
+            }
+            else
+            {
+                // differences wrap around, as in the reference encoder
+                int dr = (signed char)(px.r - prev.r);
+                int dg = (signed char)(px.g - prev.g);
+                int db = (signed char)(px.b - prev.b);
+                int dr_dg = dr - dg;
+                int db_dg = db - dg;
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+                {
+                    qoi.push_back(0x40 | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2));
+                }
+                else if (dr_dg >= -8 && dr_dg <= 7 && dg >= -32 && dg <= 31 && db_dg >= -8 && db_dg <= 7)
+                {
+                    qoi.push_back(0x80 | (dg + 32));
+                    qoi.push_back(((dr_dg + 8) << 4) | (db_dg + 8));
+                }
+                else
+                {
+                    qoi.insert(qoi.end(), { 0xFE, px.r, px.g, px.b });
+                }
+            }
+            cached = px;
+            prev = px;
+        }
+    }
+    if (run > 0)
+    {
+        qoi.push_back(0xC0 | (run - 1));
+    }
+    qoi.insert(qoi.end(), { 0, 0, 0, 0, 0, 0, 0, 1 });
+
+    return writeFile_(filename, qoi.data(), qoi.size(), 0, nullptr, 0, 0);
+}
+
+int ImageWriter::writeRaw(const std::string& filename, int width, int height, int channels, RawTypes type,
+    const void* data, int stride)
+{
+    int element_size = type == RAW_UINT8 ? 1 : 4;
+    unsigned int header[6] = { 0, 1, (unsigned int)width, (unsigned int)height, (unsigned int)channels, (unsigned int)type };
+    std::memcpy(header, "PRAW", 4);
+
+    return writeFile_(filename, header, sizeof(header), height, (const unsigned char*)data, width * channels * element_size, stride);
+}
+
+int ImageWriter::writeFloatRaw(const std::string& filename, int width, int height, const float* data, int stride)
+{
+    return writeFile_(filename, nullptr, 0, height, (const unsigned char*)data, width * sizeof(float), stride);
+}
+
+int ImageWriter::writeFloatNpy(const std::string& filename, int width, int height, const float* data, int stride)
+{
+    return writeNpy_(filename, width, height, 0, "<f4", sizeof(float), data, stride);
+}
+
+int ImageWriter::writeUIntNpy(const std::string& filename, int width, int height, const unsigned int* data, int stride)
+{
+    return writeNpy_(filename, width, height, 0, "<u4", sizeof(unsigned int), data, stride);
+}
+
+int ImageWriter::writeUByteNpy(const std::string& filename, int width, int height, int channels, const unsigned char* data, int stride)
+{
+    return writeNpy_(filename, width, height, channels, "|u1", 1, data, stride);
+}
+
+int ImageWriter::writeFaceIndexMap(const std::string& filename, int width, int height, const unsigned int* data, int stride)
+{
+    std::vector<unsigned int> runs;
+    for (int y = height - 1; y >= 0; --y)
+    {
+        const unsigned int* row = (const unsigned int*)((const unsigned char*)data + (std::size_t)y * stride);
+        for (int x = 0; x < width; ++x)
+        {
+            if (!runs.empty() && runs[runs.size() - 2] == row[x])
+            {
+                ++runs.back();
+            }
+            else
+            {
+                runs.push_back(row[x]);
+                runs.push_back(1);
+            }
+        }
+    }
+
+    unsigned int header[5] = { 0, 1, (unsigned int)width, (unsigned int)height, (unsigned int)(runs.size() / 2) };
+    std::memcpy(header, "PFID", 4);
+
+    std::FILE* file = std::fopen(filename.c_str(), "wb");
+    if (file == nullptr)
+    {
+        std::cout << "ERROR::IMAGE WRITER::Failed to open " << filename << ". Check that the path exists" << std::endl;
+        return 0;
+    }
+
+    bool success = std::fwrite(header, sizeof(unsigned int), 5, file) == 5
+        && std::fwrite(runs.data(), sizeof(unsigned int), runs.size(), file) == runs.size();
+    success = std::fclose(file) == 0 && success;
+    if (!success)
+    {
+        std::cout << "ERROR::IMAGE WRITER::Failed to write " << filename << std::endl;
+    }
+
+    return success;
+}
+
+int ImageWriter::writeNpy_(const std::string& filename, int width, int height, int channels, const char* descr, int element_size,
+    const void* data, int stride)
+{
+    std::string shape = std::to_string(height) + ", " + std::to_string(width);
+    if (channels > 0)
+    {
+        shape += ", " + std::to_string(channels);
+    }
+    std::string header = std::string("{'descr': '") + descr + "', 'fortran_order': False, 'shape': (" + shape + "), }";
+    // magic + version + header length + header should be divisible by 64; the header ends with '\n'
+    std::size_t preamble_size = 10;
+    std::size_t padded_size = ((preamble_size + header.size() + 1 + 63) / 64) * 64;
+    header.append(padded_size - preamble_size - header.size() - 1, ' ');
+    header.push_back('\n');
+
+    std::vector<unsigned char> preamble = { 0x93, 'N', 'U', 'M', 'P', 'Y', 1, 0 };
+    preamble.push_back(header.size() & 0xFF);
+    preamble.push_back((header.size() >> 8) & 0xFF);
+    preamble.insert(preamble.end(), header.begin(), header.end());
+
+    int row_size = width * std::max(channels, 1) * element_size;
+    return writeFile_(filename, preamble.data(), preamble.size(), height, (const unsigned char*)data, row_size, stride);
+}
+
+int ImageWriter::writePNG_(const std::string& filename, int width, int height, int bit_depth, int color_type,
+    const std::vector<unsigned char>& scanlines, int compression_level)
+{
+    std::vector<unsigned char> zlib_stream;
+    unsigned char* compressed = nullptr;
+    int compressed_size = 0;
+    if (compression_level > 0)
+    {
+        compressed = stbi_zlib_compress((unsigned char*)scanlines.data(), (int)scanlines.size(), &compressed_size,
+            compression_level);
+        if (compressed == nullptr)
+        {
+            std::cout << "ERROR::IMAGE WRITER::Failed to compress " << filename << std::endl;
+            return 0;
+        }
+    }
+    else
+    {
+        // stored deflate blocks of at most 64K each
+        const std::size_t max_block = 65535;
+        zlib_stream.reserve(scanlines.size() + (scanlines.size() / max_block + 1) * 5 + 6);
+        zlib_stream.push_back(0x78);
+        zlib_stream.push_back(0x01);
+        std::size_t pos = 0;
+        do
+        {
+            std::size_t size = std::min(max_block, scanlines.size() - pos);
+            bool last = pos + size == scanlines.size();
+            zlib_stream.push_back(last ? 1 : 0);
+            zlib_stream.push_back(size & 0xFF);
+            zlib_stream.push_back((size >> 8) & 0xFF);
+            zlib_stream.push_back(~size & 0xFF);
+            zlib_stream.push_back((~size >> 8) & 0xFF);
+            zlib_stream.insert(zlib_stream.end(), scanlines.begin() + pos, scanlines.begin() + pos + size);
+            pos += size;
+        } while (pos < scanlines.size());
+        putBigEndian32(zlib_stream, adler32_(scanlines.data(), scanlines.size()));
+    }
+
+    std::vector<unsigned char> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    auto put_chunk = [&png](const char* type, const unsigned char* chunk_data, std::size_t size)
+    {
+        putBigEndian32(png, (unsigned int)size);
+        std::size_t type_start = png.size();
+        png.insert(png.end(), type, type + 4);
+        png.insert(png.end(), chunk_data, chunk_data + size);
+        putBigEndian32(png, crc32_(&png[type_start], size + 4));
+    };
+
+    std::vector<unsigned char> header;
+    putBigEndian32(header, width);
+    putBigEndian32(header, height);
+    header.push_back(bit_depth);
+    header.push_back(color_type);
+    header.push_back(0);     // deflate
+    header.push_back(0);     // adaptive filtering
+    header.push_back(0);     // no interlace
+    put_chunk("IHDR", header.data(), header.size());
+    if (compressed != nullptr)
+    {
+        put_chunk("IDAT", compressed, compressed_size);
+        std::free(compressed);     // allocated by stb with the default STBIW_MALLOC
+    }
+    else
+    {
+        put_chunk("IDAT", zlib_stream.data(), zlib_stream.size());
+    }
+    put_chunk("IEND", nullptr, 0);
+
+    return writeFile_(filename, png.data(), png.size(), 0, nullptr, 0, 0);
+}
+
+int ImageWriter::writeFile_(const std::string& filename, const void* header, std::size_t header_size,
+    int height, const unsigned char* data, int row_size, int stride)
+{
+    std::FILE* file = std::fopen(filename.c_str(), "wb");
+    if (file == nullptr)
+    {
+        std::cout << "ERROR::IMAGE WRITER::Failed to open " << filename << ". Check that the path exists" << std::endl;
+        return 0;
+    }
+
+    bool success = (header_size == 0 || std::fwrite(header, 1, header_size, file) == header_size)
+        && writeRowsTopDown_(file, height, data, row_size, stride);
+    success = std::fclose(file) == 0 && success;
+    if (!success)
+    {
+        std::cout << "ERROR::IMAGE WRITER::Failed to write " << filename << std::endl;
+    }
+
+    return success;
+}
+
+bool ImageWriter::writeRowsTopDown_(std::FILE* file, int height, const unsigned char* data, int row_size, int stride)
+{
+    for (int y = height - 1; y >= 0; --y)
+    {
+        if (std::fwrite(data + (std::size_t)y * stride, 1, row_size, file) != (std::size_t)row_size)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+unsigned int ImageWriter::adler32_(const unsigned char* data, std::size_t size)
+{
+    // sums are reduced often enough to never overflow
+    const unsigned int base = 65521;
+    unsigned int a = 1, b = 0;
+    while (size > 0)
+    {
+        std::size_t chunk = std::min(size, (std::size_t)5552);
+        for (std::size_t i = 0; i < chunk; ++i)
+        {
+            a += data[i];
+            b += a;
+        }
+        a %= base;
+        b %= base;
+        data += chunk;
+        size -= chunk;
+    }
+    return (b << 16) | a;
+}
+
+unsigned int ImageWriter::crc32_(const unsigned char* data, std::size_t size, unsigned int crc)
+{
+    // built once, thread-safe: the writers run on the encoder threads
+    struct Table
+    {
+        unsigned int values[256];
+        Table()
+        {
+            for (unsigned int n = 0; n < 256; ++n)
+            {
+                unsigned int c = n;
+                for (int k = 0; k < 8; ++k)
+                {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                values[n] = c;
+            }
+        }
+    };
+    static const Table table;
+
+    crc = ~crc;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        crc = table.values[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
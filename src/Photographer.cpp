@@ -1,9 +1,9 @@
 #include "../header/Photographer.h"
 
-float Photographer::lastX_ = 400;
-float Photographer::lastY_ = 300;
-bool Photographer::first_mouse_ = true;
-Camera* Photographer::view_camera_ = nullptr;
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <future>
 
 Photographer::Photographer(): default_camera_target_(glm::vec3(0.0f)),
 vertex_shader_type_(Shader::ShaderTypes::DEFAULT_SHADER), fragment_shader_type_(Shader::ShaderTypes::DEFAULT_SHADER)
@@ -17,6 +17,7 @@ vertex_shader_type_(vertex_shader_type), fragment_shader_type_(fragment_shader_t
 
 Photographer::~Photographer()
 {
+    closeSession_();
 }
 
 void Photographer::setTargetObject(GeneralMesh* target_object)
@@ -40,17 +41,36 @@ void Photographer::setShader(Shader::ShaderTypes vertex_shader_type, Shader::Sha
 
 void Photographer::viewScene(bool loop)
 {
-    GLFWwindow* window = initWindowContext_(true);
+    if (session_open_)
+    {
+        std::cout << "ERROR::VIEW SCENE::Render session is open. Close it before viewing the scene" << std::endl;
+        return;
+    }
+
+    if (!initWindowContext_(true))
+    {
+        return;
+    }
+    GLFWwindow* window = context_->getWindow();
     registerCallbacks_(window);
     
-    setUpScene_();
+    if (!setUpScene_())
+    {
+        cleanAndCloseContext_();
+        return;
+    }
+    // camera models are only drawn here
+    if (simple_shader_ == nullptr)
+    {
+        simple_shader_ = new Shader(Shader::NOTEXTURE_SHADER, Shader::DEFAULT_SHADER);   // use default fragment shader
+    }
 
     view_camera_ = new Camera(win_width_, win_height_);
     view_camera_->setPosition(default_camera_position_);
 
     // operating the view
-    Photographer::lastX_ = win_width_/2;
-    Photographer::lastY_ = win_height_/2;
+    lastX_ = win_width_/2;
+    lastY_ = win_height_/2;
     first_mouse_ = true;
     last_frame_time_ = glfwGetTime();
 
@@ -64,8 +84,7 @@ void Photographer::viewScene(bool loop)
         processInput_(window);
 
         clearBackground_();
-        cameraParamsToShader_(*shader_, *view_camera_);
-        cameraParamsToShader_(*simple_shader_, *view_camera_);
+        cameraParamsToUniforms_(*view_camera_);
         drawMainObject_(*shader_);
         drawImageCameraObjects_(*simple_shader_);
 
@@ -79,638 +98,2937 @@ void Photographer::viewScene(bool loop)
 
 std::vector<std::string> Photographer::renderToImages(const std::string path, const std::string prefix)
 {
-    bool default_camera = false;
-    if (image_cameras_.size() == 0)
-    {
-        std::cout << 
-            "WARNING::RENDER TO FILE:: No Cameras Set; using default camera. Use addCameraToPosition() to set up cameras" 
-            << std::endl;
-        Camera camera = createDefaultTargetCamera_();
-        image_cameras_.push_back(camera);
-
-        default_camera = true;
-    }
     mg::mkDir(path);
 
-    std::vector<std::string> save_name_list;
-    GLFWwindow* window = initWindowContext_(false);
-    initCustomBuffer_();
-
-    setUpScene_();
-
-    for (auto &&camera: image_cameras_)
+    // files are just one of the consumers of the frames
+    std::vector<std::string> submitted_names;
+    submitted_names.reserve(image_cameras_.size());
+    ImageFormats image_format = image_format_;
+    int png_compression_level = png_compression_level_;
+    DepthFormats depth_format = depth_format_;
+    float depth_png_scale = depth_png_scale_;
+    FaceIndexFormats face_idx_format = face_idx_format_;
+    std::vector<int> encoded = renderFrames_(true, [&path, &prefix, &submitted_names, image_format, png_compression_level, 
+        depth_format, depth_png_scale, face_idx_format]
+        (Frame& frame, ImageEncoderPool& encoder)
     {
-        std::string save_name = prefix + std::to_string(camera.getID()) + ".png";
-
-        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
-
-        // render
-        clearBackground_();
-        cameraParamsToShader_(*shader_, camera);
-        drawMainObject_(*shader_);
+        std::string name = prefix + std::to_string(frame.view.camera_id) + "." + imageFileExtension_(image_format);
+        std::string filename = path + "/" + name;
+        encoder.submit([filename, frame, image_format, png_compression_level]()
+        {
+            return saveImageToFile_(filename, image_format, png_compression_level, frame.view);
+        });
+        submitted_names.push_back(name);
 
-        // Switch to default & save 
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        if (saveRGBTexToFile_(path + "/" + save_name, texture_color_buffer_))  // if the save finished sucessfully
+        if (frame.depth.data != nullptr)
         {
-            save_name_list.push_back(save_name);
+            std::string depth_name = prefix + std::to_string(frame.view.camera_id) + "_depth." 
+                + depthFileExtension_(depth_format);
+            std::string depth_filename = path + "/" + depth_name;
+            encoder.submit([depth_filename, frame, depth_format, depth_png_scale, png_compression_level]()
+            {
+                return saveDepthToFile_(depth_filename, depth_format, depth_png_scale, png_compression_level, frame.depth);
+            });
+            submitted_names.push_back(depth_name);
         }
-    }
 
-    cleanAndCloseContext_();
+        if (frame.face_idx.data != nullptr)
+        {
+            std::string face_idx_name = prefix + std::to_string(frame.view.camera_id) + "_faces."
+                + faceIndexFileExtension_(face_idx_format);
+            std::string face_idx_filename = path + "/" + face_idx_name;
+            encoder.submit([face_idx_filename, frame, face_idx_format]()
+            {
+                return saveFaceIndicesToFile_(face_idx_filename, face_idx_format, frame.face_idx);
+            });
+            submitted_names.push_back(face_idx_name);
+        }
+    });
 
-    if (default_camera)
+    // tickets are given in the submission order == camera order
+    std::vector<std::string> save_name_list;
+    for (std::size_t ticket = 0; ticket < encoded.size(); ++ticket)
     {
-        image_cameras_.pop_back();
+        if (encoded[ticket])  // if the save finished sucessfully
+        {
+            save_name_list.push_back(submitted_names[ticket]);
+        }
     }
 
     return save_name_list;
 }
 
-void Photographer::saveImageCamerasParamsCV(const std::string path, const std::string prefix)
+std::vector<Frame> Photographer::renderToFrames()
 {
-    mg::mkDir(path);
-    if (image_cameras_.size() == 0)
+    std::vector<Frame> frames;
+    frames.reserve(image_cameras_.size());
+    renderFrames_(true, [&frames](Frame& frame, ImageEncoderPool&)
     {
-        std::cout << "WARNING::SAVE CAMERA PARAMETERS :: No Cameras Set; Saving parameters of the default camera" << std::endl;
+        frames.push_back(std::move(frame));
+    });
 
-        Camera camera = createDefaultTargetCamera_();
-        camera.saveParamsForOpenCV(path, prefix);
+    return frames;
+}
+
+void Photographer::renderToCallback(FrameCallback on_frame)
+{
+    if (!on_frame)
+    {
+        std::cout << "ERROR::RENDER TO CALLBACK::No callback given. Nothing is rendered" << std::endl;
         return;
     }
 
-    for (auto camera : image_cameras_)
+    renderFrames_(false, [&on_frame](Frame& frame, ImageEncoderPool&)
     {
-        camera.saveParamsForOpenCV(path, prefix);
-    }
+        on_frame(frame.view);
+    });
 }
 
-void Photographer::setObject(GeneralMesh * object)
+int Photographer::renderToArchive(const std::string filename)
 {
-    object_ = object;
-}
+    FrameArchiveWriter archive;
+    if (!archive.open(filename))
+    {
+        return 0;
+    }
 
-void Photographer::addCameraToPosition(float x, float y, float z, float dist)
-{
-    Camera camera(win_width_, win_height_);
+    std::vector<int> stored = renderFrames_(true, [&archive](Frame& frame, ImageEncoderPool& encoder)
+    {
+        encoder.submit([&archive, frame]()
+        {
+            return archive.addFrame(frame);
+        });
+    });
 
-    glm::vec3 position = glm::vec3(x, y, z);
-    if (dist > 0.0)
+    if (image_cameras_.size() == 0)
     {
-        position -= default_camera_target_;
-        position = dist * glm::normalize(position);
+        Camera camera = createDefaultTargetCamera_();
+        archive.addCamera(CameraParamsWriter::record(camera));
+    }
+    for (auto &&camera : image_cameras_)
+    {
+        archive.addCamera(CameraParamsWriter::record(camera));
+    }
+    if (!archive.finish())
+    {
+        return 0;
     }
-    
-    camera.setPosition(position);
-    camera.setTarget(default_camera_target_);
 
-    image_cameras_.push_back(camera);
+    return (int)std::count(stored.begin(), stored.end(), 1);
 }
 
-void Photographer::addCameraRingRoutine(int total_num, float y, float dist)
+int Photographer::renderToDataset(const std::string path, DatasetWriter::Formats formats, bool with_masks)
 {
-    float order_f, total_num_f, theta;
-    
-    total_num_f= (float)total_num;
-
-    for (int order = 0; order < total_num; ++order) {
-        order_f = (float)order;
-        theta = glm::radians(360.0f * order_f / total_num_f);
-        
-        addCameraToPosition(glm::cos(theta), y, glm::sin(theta), dist);
+    if (with_masks && fragment_shader_type_ == Shader::DEFAULT_SHADER)
+    {
+        // masks come from the face indices -- they would be empty
+        std::cout << "ERROR::RENDER TO DATASET::DEFAULT fragment shader doesn't output face indices, "
+            << "masks can't be made. Nothing is rendered" << std::endl;
+        return 0;
     }
-}
-
-void Photographer::addCameraToPositionShaker(float x, float y, float z, float dist)
-{
-    addCameraToPositionShaker(
-        x, 0.1f, 0.05f,
-        y, 0.1f, 0.05f,
-        z, 0.1f, 0.05f,
-        dist);
-}
 
-void Photographer::addCameraToPositionShaker(
-    float x, float x_range, float x_counter,
-    float y, float y_range, float y_counter,
-    float z, float z_range, float z_counter, float dist) {
+    mg::mkDir(path);
+    mg::mkDir(path + "/images");
+    if (depth_export_)
+    {
+        mg::mkDir(path + "/depth");
+    }
+    if (with_masks)
+    {
+        mg::mkDir(path + "/masks");
+    }
+    if (formats & DatasetWriter::COLMAP)
+    {
+        mg::mkDir(path + "/sparse");
+        mg::mkDir(path + "/sparse/0");
+    }
 
-    for (float k = z - z_range; k < z + z_range + z_counter * 0.5; k += z_counter) {
-        for (float j = y - y_range; j < y + y_range + y_counter * 0.5; j += y_counter) {
-            for (float i = x - x_range; i < x + x_range + x_counter * 0.5; i += x_counter) {
-                this->addCameraToPosition(i, j, k, dist);
-            }
-        }
+    DatasetWriter dataset;
+    if (!dataset.open(path, formats))
+    {
+        return 0;
     }
 
-}
-Eigen::RowVector3d Photographer::getDefaultCameraPosition() const {
-    Eigen::RowVector3d ret;
-    ret(0) = default_camera_position_[0];
-    ret(1) = default_camera_position_[1];
-    ret(2) = default_camera_position_[2];
+    // poses are known before the rendering: the encoder threads don't touch the cameras
+    std::map<unsigned int, DatasetWriter::View> views;
+    if (image_cameras_.size() == 0)
+    {
+        Camera camera = createDefaultTargetCamera_();
+        views[camera.getID()] = datasetView_(camera);
+    }
+    for (auto &&camera : image_cameras_)
+    {
+        views[camera.getID()] = datasetView_(camera);
+    }
 
-    return ret;
-}
+    // masks come from the face indices
+    bool face_idx_export = face_idx_export_;
+    face_idx_export_ = face_idx_export_ || with_masks;
+
+    ImageFormats image_format = image_format_;
+    int png_compression_level = png_compression_level_;
+    DepthFormats depth_format = depth_format_;
+    float depth_png_scale = depth_png_scale_;
+    std::vector<int> stored = renderFrames_(true, [&path, &views, &dataset, with_masks, image_format, png_compression_level,
+        depth_format, depth_png_scale]
+        (Frame& frame, ImageEncoderPool& encoder)
+    {
+        DatasetWriter::View view = views[frame.view.camera_id];
+        std::string name = "view_" + std::to_string(frame.view.camera_id);
+        view.image_name = "images/" + name + "." + imageFileExtension_(image_format);
+        if (frame.depth.data != nullptr)
+        {
+            view.depth_name = "depth/" + name + "_depth." + depthFileExtension_(depth_format);
+        }
+        if (with_masks && frame.face_idx.data != nullptr)
+        {
+            view.mask_name = "masks/" + name + "_mask.png";
+        }
 
-Eigen::RowVector3d Photographer::getDefaultProjectPlaneNormal() const {
-    Eigen::RowVector3d ret;
-    ret(0) = default_camera_target_[0] - default_camera_position_[0];
-    ret(1) = default_camera_target_[1] - default_camera_position_[1];
-    ret(2) = default_camera_target_[2] - default_camera_position_[2];
+        encoder.submit([&path, &dataset, view, frame, image_format, png_compression_level, depth_format, depth_png_scale]()
+        {
+            int success = saveImageToFile_(path + "/" + view.image_name, image_format, png_compression_level, frame.view);
+            if (success && !view.depth_name.empty())
+            {
+                success = saveDepthToFile_(path + "/" + view.depth_name, depth_format, depth_png_scale, png_compression_level,
+                    frame.depth);
+            }
+            if (success && !view.mask_name.empty())
+            {
+                success = saveMaskToFile_(path + "/" + view.mask_name, frame.face_idx);
+            }
+            // only the complete views are listed
+            return success && dataset.addView(view);
+        });
+    });
+    face_idx_export_ = face_idx_export;
 
-    return ret;
+    return (int)std::count(stored.begin(), stored.end(), 1);
 }
 
-Eigen::RowVector3d Photographer::getCameraProjectPlaneNormal(int camera_idx) const {
-    Eigen::RowVector3d ret;
-    
-    if (image_cameras_.size() >= camera_idx) {
-
+std::vector<FaceVisibility> Photographer::computeFaceVisibility()
+{
+    CameraRig::Handle default_camera;
+    if (image_cameras_.size() == 0)
+    {
+        std::cout << 
+            "WARNING::FACE VISIBILITY:: No Cameras Set; using default camera. Use addCameraToPosition() to set up cameras" 
+            << std::endl;
+        default_camera = image_cameras_.add(createDefaultTargetCamera_());
     }
+    // same depth precision as in the rendered images
+    ClippingPlanes user_planes = fitClippingPlanes_();
 
-    ret(0) = default_camera_target_[0] - default_camera_position_[0];
-    ret(1) = default_camera_target_[1] - default_camera_position_[1];
-    ret(2) = default_camera_target_[2] - default_camera_position_[2];
-
-    return ret;
-}
+    std::vector<FaceVisibility> visibility;
+    if (render_backend_type_ == SOFTWARE_RENDER_BACKEND)
+    {
+        visibility = computeFaceVisibilitySoftware_();
+    }
+    else
+    {
+        visibility = computeFaceVisibilityGL_();
+    }
 
-const std::vector<Camera> Photographer::getImageCameras() {
-    return image_cameras_;
+    restoreClippingPlanes_(user_planes);
+    image_cameras_.remove(default_camera);
+    return visibility;
 }
 
-void Photographer::setUpScene_()
+std::vector<int> Photographer::renderFrames_(bool owned_frames, const FrameSink& sink)
 {
-    createShaders_();
-    createTargetObjectVAO_();
-    createCameraObjectVAO_();
-    setUpTargetObjectColor_();
-    setUpLight_();
-}
+    CameraRig::Handle default_camera;
+    if (image_cameras_.size() == 0)
+    {
+        std::cout << 
+            "WARNING::RENDER:: No Cameras Set; using default camera. Use addCameraToPosition() to set up cameras" 
+            << std::endl;
+        default_camera = image_cameras_.add(createDefaultTargetCamera_());
+    }
+    std::vector<int> encoded;
+    if (face_idx_export_ && fragment_shader_type_ == Shader::DEFAULT_SHADER)
+    {
+        // the maps would be all background
+        std::cout << "ERROR::RENDER::DEFAULT fragment shader doesn't output face indices. Nothing is rendered" << std::endl;
+        image_cameras_.remove(default_camera);
+        return encoded;
+    }
 
-void Photographer::createTargetObjectVAO_()
-{
-    if (object_vertex_array_ > 0
-        || object_vertex_buffer_ > 0
-        || object_element_buffer_ > 0)
+    ClippingPlanes user_planes = fitClippingPlanes_();
+    if (render_backend_type_ == SOFTWARE_RENDER_BACKEND)
     {
-        std::cout << "ERROR::CREATE OBJECT BUFFERS::OBJECT BUFFERS WERE ALREADY ALLOCATED. DATA IS LOST\n" << std::endl;
+        encoded = renderFramesSoftware_(sink);
+        restoreClippingPlanes_(user_planes);
+        image_cameras_.remove(default_camera);
+        return encoded;
     }
 
-    glGenVertexArrays(1, &object_vertex_array_);
-    glBindVertexArray(object_vertex_array_);
+    // everything is already set up within the session
+    bool own_context = !session_open_;
+    if ((own_context && !initRenderContext_()) || (!own_context && !updateScene_()))
+    {
+        std::cout << "ERROR::RENDER::Failed to set up the context. Nothing is rendered" << std::endl;
+        restoreClippingPlanes_(user_planes);
+        image_cameras_.remove(default_camera);
+        return encoded;
+    }
 
-    switch (vertex_shader_type_) {
-    case Shader::ShaderTypes::NOTEXTURE_SHADER:
+    std::vector<ImageSize> image_sizes = imageSizes_();
+    if (atlas_rendering_ && !perCameraOutputs_() && image_sizes.size() == 1 && initAtlasBuffers_(image_sizes[0]))
     {
-        glGenBuffers(1, &object_vertex_buffer_);
-        glBindBuffer(GL_ARRAY_BUFFER, object_vertex_buffer_);
-        glBufferData(GL_ARRAY_BUFFER,
-            object_->getGLNormalizedVertices().size() * sizeof(GeneralMesh::GLMVertex),
-            &object_->getGLNormalizedVertices()[0], GL_STATIC_DRAW);
+        renderAtlasesToSink_(owned_frames, sink, *encoder_);
+    }
+    else
+    {
+        renderCamerasToSink_(owned_frames, sink, *encoder_);
+    }
 
-        glGenBuffers(1, &object_element_buffer_);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, object_element_buffer_);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-            object_->getGLMFaces().size() * sizeof(unsigned int),
-            &object_->getGLMFaces()[0], GL_STATIC_DRAW);
+    // the tasks should be done before the encoder goes away with the context
+    encoded = encoder_->finish();
 
-        // position
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GeneralMesh::GLMVertex), (void*)0);
-        glEnableVertexAttribArray(0);
-        // normals
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(GeneralMesh::GLMVertex),
-            (void*)offsetof(GeneralMesh::GLMVertex, GeneralMesh::GLMVertex::normal));
-        glEnableVertexAttribArray(1);
-        break; 
+    if (own_context)
+    {
+        cleanAndCloseContext_();
     }
-    case Shader::ShaderTypes::TEXTURE_SHADER:
+
+    restoreClippingPlanes_(user_planes);
+    image_cameras_.remove(default_camera);
+
+    return encoded;
+}
+
+std::vector<int> Photographer::renderFramesSoftware_(const FrameSink& sink)
+{
+    std::vector<int> encoded;
+    if (!SoftwareRasterizer::isSupported(vertex_shader_type_) || vertex_shader_type_ != fragment_shader_type_)
     {
-        glGenBuffers(1, &object_vertex_buffer_);
-        glBindBuffer(GL_ARRAY_BUFFER, object_vertex_buffer_);
-        glBufferData(GL_ARRAY_BUFFER,
-            ((GeneralMeshTexture *)object_)->getGLNormalizedVerticesWithUV().size() * sizeof(GeneralMeshTexture::GLMVertexWithUV),
-            &((GeneralMeshTexture *)object_)->getGLNormalizedVerticesWithUV()[0], GL_STATIC_DRAW);
+        std::cout << "ERROR::RENDER::Software renderer supports NOTEXTURE, TEXTURE, FACEIDX and FLAT shaders "
+            << "(same for vertex and fragment). Nothing is rendered" << std::endl;
+        return encoded;
+    }
 
+    if (multisample_samples_ > 1)
+    {
+        std::cout << "WARNING::RENDER::Multisampling is not available in the software renderer. Rendering without it" << std::endl;
+    }
 
-        // position
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GeneralMeshTexture::GLMVertexWithUV), (void*)0);
-        glEnableVertexAttribArray(0);
-        // normals
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(GeneralMeshTexture::GLMVertexWithUV),
-            (void*)offsetof(GeneralMeshTexture::GLMVertexWithUV, GeneralMeshTexture::GLMVertexWithUV::normal));
-        glEnableVertexAttribArray(1);
+    SoftwareRasterizer rasterizer(image_cameras_[0].getWidth(), image_cameras_[0].getHeight(), 
+        std::max(1u, std::thread::hardware_concurrency()));
+    rasterizer.setShaderType(vertex_shader_type_);
+    rasterizer.setShadingParams(shading_params_);
+    loadSoftwareGeometry_(rasterizer);
 
-        const GeneralMeshTexture::TextureInfo& tex = ((GeneralMeshTexture *)object_)->getTexInfo();
-        glActiveTexture(GL_TEXTURE0);
+    // no GL => no session is needed, but the encoder of the open one can be reused
+    ImageEncoderPool* encoder = encoder_ != nullptr ? encoder_ : new ImageEncoderPool(encoder_threads_, encoder_queue_size_);
 
-        glGenTextures(1, &object_texture_);
+    for (auto &&camera : image_cameras_)
+    {
+        int width = camera.getWidth();
+        int height = camera.getHeight();
+        rasterizer.setImageSize(width, height);
+
+        // rendered right into the buffer of the frame. Rows are bottom-up, as in GL
+        std::size_t image_size = (std::size_t)width * height * 3;
+        ImageEncoderPool::PixelBuffer image = encoder->acquireBuffer(image_size);
+        ImageEncoderPool::PixelBuffer face_idx;
+        if (face_idx_export_)
+        {
+            face_idx = encoder->acquireBuffer((std::size_t)width * height * sizeof(unsigned int));
+        }
+        rasterizer.render(camera.getGlViewMatrix(), camera.getGlProjectionMatrix(), camera.getPosition(), image->data(),
+            face_idx ? (unsigned int*)face_idx->data() : nullptr);
 
-        glBindTexture(GL_TEXTURE_2D, object_texture_);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, tex.width, tex.height, 0, GL_RGB, GL_UNSIGNED_BYTE, tex.data);
-        float borderColor[] = { 1.0f, 1.0f, 0.0f, 1.0f };
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-        glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        Frame frame;
+        frame.view = rgbImageView_(image->data(), width, height, width * 3, camera.getID());
+        frame.pixels = std::move(image);
+        if (face_idx)
+        {
+            frame.face_idx = scalarImageView_(face_idx->data(), width, height, camera.getID());
+            frame.face_idx_pixels = std::move(face_idx);
+        }
+        if (depth_export_)
+        {
+            setFrameDepth_(frame, rasterizer.depth(), camera, width, height, *encoder);
+        }
+        sink(frame, *encoder);
+    }
 
+    encoded = encoder->finish();
+    if (encoder != encoder_)
+    {
+        delete encoder;
+    }
 
-        //stbi_image_free(tex.data);
+    return encoded;
+}
 
-        //glActiveTexture(GL_TEXTURE0);
-        //glBindTexture(GL_TEXTURE_2D, object_texture_);
+void Photographer::loadSoftwareGeometry_(SoftwareRasterizer& rasterizer)
+{
+    std::vector<SoftwareRasterizer::Vertex> vertices;
+    std::vector<unsigned int> indices;
 
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(GeneralMeshTexture::GLMVertexWithUV),
-            (void*)offsetof(GeneralMeshTexture::GLMVertexWithUV, GeneralMeshTexture::GLMVertexWithUV::uv));
-        glEnableVertexAttribArray(2);
+    // same data as uploaded by uploadTargetObjectData_()
+    switch (vertex_shader_type_) {
+    case Shader::ShaderTypes::NOTEXTURE_SHADER:
+    {
+        for (auto &&in : object_->getGLNormalizedVertices())
+        {
+            SoftwareRasterizer::Vertex vertex = {};
+            vertex.position = in.position;
+            vertex.normal = in.normal;
+            vertices.push_back(vertex);
+        }
+        indices.assign(object_->getGLMFaces().begin(), object_->getGLMFaces().end());
+        break;
+    }
+    case Shader::ShaderTypes::TEXTURE_SHADER:
+    {
+        for (auto &&in : ((GeneralMeshTexture *)object_)->getGLNormalizedVerticesWithUV())
+        {
+            SoftwareRasterizer::Vertex vertex = {};
+            vertex.position = in.position;
+            vertex.normal = in.normal;
+            vertex.uv = in.uv;
+            vertices.push_back(vertex);
+        }
+        const GeneralMeshTexture::TextureInfo& tex = ((GeneralMeshTexture *)object_)->getTexInfo();
+        rasterizer.setTexture(tex.data, tex.width, tex.height);
         break;
     }
     case Shader::ShaderTypes::FACEIDX_SHADER:
     {
-        glGenBuffers(1, &object_vertex_buffer_);
-        glBindBuffer(GL_ARRAY_BUFFER, object_vertex_buffer_);
-        glBufferData(GL_ARRAY_BUFFER,
-            ((GeneralMeshIdx *)object_)->getGLNormalizedVerticesWithId().size() * sizeof(GeneralMeshIdx::GLMVertexWithId),
-            &((GeneralMeshIdx *)object_)->getGLNormalizedVerticesWithId()[0], GL_STATIC_DRAW);
-
-        // position
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GeneralMeshIdx::GLMVertexWithId), (void*)0);
-        glEnableVertexAttribArray(0);
-        // normals
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(GeneralMeshIdx::GLMVertexWithId),
-            (void*)offsetof(GeneralMeshIdx::GLMVertexWithId, GeneralMeshIdx::GLMVertexWithId::faceid));
-        glEnableVertexAttribArray(1);
+        for (auto &&in : ((GeneralMeshIdx *)object_)->getGLNormalizedVerticesWithId())
+        {
+            SoftwareRasterizer::Vertex vertex = {};
+            vertex.position = in.position;
+            vertex.color = in.faceid;
+            vertices.push_back(vertex);
+        }
         break;
     }
     case Shader::ShaderTypes::FLAT_SHADER:
     {
-        glGenBuffers(1, &object_vertex_buffer_);
-        glBindBuffer(GL_ARRAY_BUFFER, object_vertex_buffer_);
-        glBufferData(GL_ARRAY_BUFFER,
-            ((ParsingMesh*)object_)->getGLNormalizedVerticesWithColor().size() * sizeof(ParsingMesh::GLMVertexWithColor),
-            &((ParsingMesh*)object_)->getGLNormalizedVerticesWithColor()[0], GL_STATIC_DRAW);
-        
-        // position
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ParsingMesh::GLMVertexWithColor), (void*)0);
-        glEnableVertexAttribArray(0);
-        // normals
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(ParsingMesh::GLMVertexWithColor),
-            (void*)offsetof(ParsingMesh::GLMVertexWithColor, ParsingMesh::GLMVertexWithColor::color));
-        glEnableVertexAttribArray(1);
+        for (auto &&in : ((ParsingMesh*)object_)->getGLNormalizedVerticesWithColor())
+        {
+            SoftwareRasterizer::Vertex vertex = {};
+            vertex.position = in.position;
+            vertex.color = in.color;
+            vertices.push_back(vertex);
+        }
         break;
     }
     default:
         break;
     }
-    // Cleaning
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    // non-indexed pipelines draw the vertices in order
+    if (indices.empty())
+    {
+        std::size_t n_vertices = std::min(vertices.size(), (std::size_t)object_->getFaces().size());
+        for (std::size_t i = 0; i < n_vertices; ++i)
+        {
+            indices.push_back((unsigned int)i);
+        }
+    }
+
+    rasterizer.setGeometry(std::move(vertices), std::move(indices));
 }
 
-void Photographer::createCameraObjectVAO_()
+void Photographer::renderCamerasToSink_(bool owned_frames, const FrameSink& sink, ImageEncoderPool& encoder)
 {
-    if (cam_obj_vertex_array_ > 0
-        || cam_obj_vertex_buffer_ > 0
-        || cam_obj_element_buffer_ > 0)
+    std::vector<ImageSize> image_sizes = imageSizes_();
+    std::size_t cameras_per_pass = 1;
+    if (cameras_per_pass_ > 1 && !perCameraOutputs_() && image_sizes.size() == 1 && initLayeredRendering_(image_sizes[0]))
     {
-        std::cout << "ERROR::CREATE OBJECT BUFFERS::OBJECT BUFFERS WERE ALREADY ALLOCATED. DATA IS LOST\n" << std::endl;
+        cameras_per_pass = cameras_per_pass_;
+    }
+
+    // framebuffers for all the sizes are ready before the first camera, the readback buffers fit the largest image
+    std::size_t max_pixels = 0;
+    for (auto &&size : image_sizes)
+    {
+        if (cameras_per_pass == 1)
+        {
+            initRenderTarget_(size, face_idx_export_, true);
+        }
+        max_pixels = std::max(max_pixels, (std::size_t)size.first * size.second);
+    }
+    initReadbackBuffers_(max_pixels);
+
+    // frames in flight are handed to the sink in the order they were rendered
+    std::size_t pending_cameras[readback_ring_size_] = { 0 };
+    std::size_t frame = 0;
+    auto pass_on_in_flight = [&]()
+    {
+        for (std::size_t i = 0; i < readback_ring_size_; ++i)
+        {
+            std::size_t slot = (frame + i) % readback_ring_size_;
+            if (readback_fences_[slot] != nullptr)
+            {
+                finishReadback_(slot, image_cameras_[pending_cameras[slot]], owned_frames, sink, encoder);
+            }
+        }
+    };
+    for (std::size_t first = 0; first < image_cameras_.size(); first += cameras_per_pass)
+    {
+        std::size_t n_cameras = std::min(cameras_per_pass, image_cameras_.size() - first);
+
+        // render
+        if (cameras_per_pass > 1)
+        {
+            drawLayeredPass_(first, n_cameras);
+        }
+        else
+        {
+            const Camera& camera = image_cameras_[first];
+            std::size_t n_pixels = (std::size_t)camera.getWidth() * camera.getHeight();
+            if (n_pixels * 3 > readback_buffer_size_)
+            {
+                // enlarged by a frame callback: the buffers are re-allocated once the frames in flight are out
+                pass_on_in_flight();
+                initReadbackBuffers_(n_pixels);
+            }
+            const RenderTarget& target = renderTarget_(camera, face_idx_export_, true);
+            glBindFramebuffer(GL_FRAMEBUFFER, target.multisample_framebuffer ? target.multisample_framebuffer : target.framebuffer);
+            glViewport(0, 0, target.width, target.height);
+            clearBackground_();
+            if (face_idx_export_)
+            {
+                GLuint background[4] = { Frame::background_face_idx, 0, 0, 0 };
+                glClearBufferuiv(GL_COLOR, 1, background);
+            }
+            cameraParamsToUniforms_(camera);
+            drawMainObject_(*shader_);
+            if (target.multisample_framebuffer)
+            {
+                resolveMultisampling_(target);
+            }
+        }
+
+        for (std::size_t layer = 0; layer < n_cameras; ++layer)
+        {
+            std::size_t slot = frame % readback_ring_size_;
+            pending_cameras[slot] = first + layer;
+
+            if (cameras_per_pass > 1)
+            {
+                glBindFramebuffer(GL_FRAMEBUFFER, layer_read_framebuffer_);
+                glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, layered_color_buffer_, 0, layer);
+            }
+
+            // request the pixels, but don't wait for them
+            const Camera& camera = image_cameras_[first + layer];
+            startReadback_(slot, camera.getWidth(), camera.getHeight());
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            ++frame;
+
+            // the ring is full -- pass the oldest frame on while the GPU works on the current one
+            std::size_t oldest = frame % readback_ring_size_;
+            if (frame >= readback_ring_size_ && readback_fences_[oldest] != nullptr)
+            {
+                finishReadback_(oldest, image_cameras_[pending_cameras[oldest]], owned_frames, sink, encoder);
+            }
+        }
+    }
+
+    // pass on what's left in flight
+    pass_on_in_flight();
+}
+
+void Photographer::renderAtlasesToSink_(bool owned_frames, const FrameSink& sink, ImageEncoderPool& encoder)
+{
+    int tile_width = atlas_tile_width_;
+    int tile_height = atlas_tile_height_;
+
+    std::vector<unsigned int> pending_camera_ids[readback_ring_size_];
+    std::size_t atlas_idx = 0;
+    for (std::size_t first = 0; first < image_cameras_.size(); first += atlas_tiles_)
+    {
+        std::size_t slot = atlas_idx % readback_ring_size_;
+        std::size_t n_tiles = std::min(atlas_tiles_, image_cameras_.size() - first);
+
+        // render every camera into its own tile
+        glBindFramebuffer(GL_FRAMEBUFFER, atlas_framebuffer_);
+        glViewport(0, 0, atlas_width_, atlas_height_);
+        clearBackground_();
+
+        pending_camera_ids[slot].clear();
+        for (std::size_t tile = 0; tile < n_tiles; ++tile)
+        {
+            const Camera& camera = image_cameras_[first + tile];
+            pending_camera_ids[slot].push_back(camera.getID());
+
+            glViewport((tile % atlas_columns_) * tile_width, (tile / atlas_columns_) * tile_height, tile_width, tile_height);
+            cameraParamsToUniforms_(camera);
+            drawMainObject_(*shader_);
+        }
+
+        // whole atlas at once
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, atlas_readback_buffers_[slot]);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glReadPixels(0, 0, atlas_width_, atlas_height_, GL_RGB, GL_UNSIGNED_BYTE, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        atlas_readback_fences_[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        ++atlas_idx;
+
+        // the next atlas is rendered while this one is in transit
+        if (atlas_idx >= readback_ring_size_)
+        {
+            std::size_t oldest = (atlas_idx - readback_ring_size_) % readback_ring_size_;
+            finishAtlasReadback_(oldest, pending_camera_ids[oldest], owned_frames, sink, encoder);
+        }
+    }
+
+    for (std::size_t i = 0; i < readback_ring_size_; ++i)
+    {
+        std::size_t slot = (atlas_idx + i) % readback_ring_size_;
+        if (atlas_readback_fences_[slot] != nullptr)
+        {
+            finishAtlasReadback_(slot, pending_camera_ids[slot], owned_frames, sink, encoder);
+        }
+    }
+
+    glViewport(0, 0, win_width_, win_height_);
+}
+
+Photographer::ClippingPlanes Photographer::fitClippingPlanes_()
+{
+    ClippingPlanes user_planes;
+    if (!depth_export_ || object_ == nullptr || object_->getGLNormalizedVertices().empty())
+    {
+        return user_planes;
+    }
+    const std::vector<GeneralMesh::GLMVertex>& vertices = object_->getGLNormalizedVertices();
+
+    // sphere around the bounding box -- a single pass over the vertices
+    glm::vec3 min_corner = vertices[0].position;
+    glm::vec3 max_corner = vertices[0].position;
+    for (auto &&vertex : vertices)
+    {
+        min_corner = glm::min(min_corner, vertex.position);
+        max_corner = glm::max(max_corner, vertex.position);
+    }
+    glm::vec3 center = 0.5f * (min_corner + max_corner);
+    float radius = 0.5f * glm::distance(min_corner, max_corner);
+    radius = radius * 1.01f + 0.001f;     // nothing should touch the planes
+
+    user_planes.reserve(image_cameras_.size());
+    const std::vector<glm::vec3>& positions = image_cameras_.positions();
+    for (std::size_t i = 0; i < positions.size(); ++i)
+    {
+        const Camera& camera = image_cameras_[i];
+        user_planes.push_back({ image_cameras_.handleAt(i), glm::vec2(camera.getNearPlane(), camera.getFarPlane()) });
+
+        float distance = glm::distance(positions[i], center);
+        float far_plane = distance + radius;
+        // the camera might be inside the sphere -- near plane still can't be too close
+        float near_plane = std::max(distance - radius, far_plane * min_near_to_far_ratio_);
+        image_cameras_.setClippingPlanes(i, near_plane, far_plane);
+    }
+    return user_planes;
+}
+
+void Photographer::restoreClippingPlanes_(const ClippingPlanes& user_planes)
+{
+    // cameras might have been removed by a frame callback
+    for (auto &&planes : user_planes)
+    {
+        std::size_t index = image_cameras_.indexOf(planes.first);
+        if (index < image_cameras_.size())
+        {
+            image_cameras_.setClippingPlanes(index, planes.second.x, planes.second.y);
+        }
+    }
+}
+
+std::vector<std::vector<std::string>> Photographer::renderMeshBatch(const std::vector<GeneralMesh*>& meshes, const std::string path, const std::string prefix)
+{
+    std::size_t next_idx = 0;
+    return renderMeshBatch_([&meshes, &next_idx]() -> GeneralMesh*
+    {
+        return next_idx < meshes.size() ? meshes[next_idx++] : nullptr;
+    }, false, path, prefix);
+}
+
+std::vector<std::vector<std::string>> Photographer::renderMeshBatch(MeshFactory next_mesh, const std::string path, const std::string prefix)
+{
+    return renderMeshBatch_([&next_mesh]() -> GeneralMesh*
+    {
+        return next_mesh().release();
+    }, true, path, prefix);
+}
+
+std::vector<std::vector<std::string>> Photographer::renderMeshBatch_(std::function<GeneralMesh*()> next_mesh, bool own_meshes,
+    const std::string path, const std::string prefix)
+{
+    std::vector<std::vector<std::string>> save_name_lists;
+    Shader::ShaderTypes vertex_shader_type = vertex_shader_type_;
+    auto load_mesh = [next_mesh, vertex_shader_type]() -> GeneralMesh*
+    {
+        GeneralMesh* mesh = next_mesh();
+        if (mesh != nullptr)
+        {
+            prepareTargetObjectData_(mesh, vertex_shader_type);
+        }
+        return mesh;
+    };
+
+    std::future<GeneralMesh*> loading = std::async(std::launch::async, load_mesh);
+    GeneralMesh* mesh = loading.get();
+    if (mesh == nullptr)
+    {
+        std::cout << "WARNING::RENDER MESH BATCH::No meshes to render" << std::endl;
+        return save_name_lists;
+    }
+
+    // one context for the whole batch
+    GeneralMesh* user_object = object_;
+    object_ = mesh;
+    bool own_session = !session_open_;
+    if (own_session && !openSession_())
+    {
+        std::cout << "ERROR::RENDER MESH BATCH::Failed to create the context. Nothing is rendered" << std::endl;
+        object_ = user_object;
+        if (own_meshes) delete mesh;
+        return save_name_lists;
+    }
+    mg::mkDir(path);
+
+    while (mesh != nullptr)
+    {
+        // the next mesh is loaded while the current one is drawn
+        loading = std::async(std::launch::async, load_mesh);
+
+        object_ = mesh;
+        // a new mesh might reuse the address of the deleted one
+        scene_object_ = nullptr;
+        save_name_lists.push_back(
+            renderToImages(path + "/" + std::to_string(save_name_lists.size()), prefix));
+
+        if (own_meshes) delete mesh;
+        mesh = loading.get();
+    }
+
+    object_ = user_object;
+    // the uploaded mesh might be gone already
+    scene_object_ = nullptr;
+    if (own_session)
+    {
+        closeSession_();
+    }
+
+    return save_name_lists;
+}
+
+void Photographer::saveImageCamerasParamsCV(const std::string path, const std::string prefix, CameraParamsFormats format)
+{
+    mg::mkDir(path);
+    std::vector<Camera> default_cameras;
+    if (image_cameras_.size() == 0)
+    {
+        std::cout << "WARNING::SAVE CAMERA PARAMETERS :: No Cameras Set; Saving parameters of the default camera" << std::endl;
+        default_cameras.push_back(createDefaultTargetCamera_());
+    }
+    const std::vector<Camera>& cameras = default_cameras.empty() ? image_cameras_.cameras() : default_cameras;
+
+    switch (format)
+    {
+    case PARAMS_OPENCV_XML:
+        CameraParamsWriter::writeOpenCVXML(path + "/" + prefix + "cameras.xml", cameras);
+        break;
+    case PARAMS_OPENCV_YAML:
+        CameraParamsWriter::writeOpenCVYAML(path + "/" + prefix + "cameras.yml", cameras);
+        break;
+    case PARAMS_BINARY:
+        CameraParamsWriter::writeBinary(path + "/" + prefix + "cameras.pcam", cameras);
+        break;
+    case PARAMS_OPENCV_PER_CAMERA:
+    default:
+        for (auto &&camera : cameras)
+        {
+            camera.saveParamsForOpenCV(path, prefix);
+        }
+        break;
+    }
+}
+
+void Photographer::setRenderBackend(RenderBackendTypes backend_type)
+{
+    render_backend_type_ = backend_type;
+}
+
+void Photographer::setAtlasRendering(bool enable, int max_atlas_size)
+{
+    atlas_rendering_ = enable;
+    atlas_max_size_ = max_atlas_size;
+}
+
+void Photographer::setImageFormat(ImageFormats format, int png_compression_level)
+{
+    image_format_ = format;
+    png_compression_level_ = std::max(0, png_compression_level);
+}
+
+void Photographer::setDepthExport(bool enable, DepthFormats format, float png_depth_scale)
+{
+    depth_export_ = enable;
+    depth_format_ = format;
+    depth_png_scale_ = png_depth_scale;
+}
+
+void Photographer::setFaceIndexExport(bool enable, FaceIndexFormats format)
+{
+    face_idx_export_ = enable;
+    face_idx_format_ = format;
+    if (enable && fragment_shader_type_ == Shader::DEFAULT_SHADER)
+    {
+        std::cout << "WARNING::FACE INDEX EXPORT::DEFAULT fragment shader doesn't output face indices. "
+            << "Set another shader before rendering" << std::endl;
+    }
+}
+
+void Photographer::setMultisampling(int n_samples)
+{
+    multisample_samples_ = std::max(0, n_samples);
+}
+
+void Photographer::setCamerasPerPass(std::size_t n_cameras)
+{
+    if (n_cameras > layered_max_cameras_)
+    {
+        std::cout << "WARNING::SET CAMERAS PER PASS::At most " << layered_max_cameras_
+            << " cameras can be rendered in one pass. Using " << layered_max_cameras_ << std::endl;
+        n_cameras = layered_max_cameras_;
+    }
+    cameras_per_pass_ = n_cameras > 0 ? n_cameras : 1;
+}
+
+void Photographer::setObject(GeneralMesh * object)
+{
+    object_ = object;
+}
+
+CameraRig::Handle Photographer::addCameraToPosition(float x, float y, float z, float dist)
+{
+    return image_cameras_.add(createImageCamera_(glm::vec3(x, y, z), dist));
+}
+
+void Photographer::addCameraRingRoutine(int total_num, float y, float dist)
+{
+    std::vector<glm::vec3> positions;
+    RigGenerator::ring(positions, total_num, y);
+    addCameraRig(positions, dist);
+}
+
+void Photographer::addCameraToPositionShaker(float x, float y, float z, float dist)
+{
+    addCameraToPositionShaker(
+        x, 0.1f, 0.05f,
+        y, 0.1f, 0.05f,
+        z, 0.1f, 0.05f,
+        dist);
+}
+
+void Photographer::addCameraToPositionShaker(
+    float x, float x_range, float x_counter,
+    float y, float y_range, float y_counter,
+    float z, float z_range, float z_counter, float dist) {
+
+    // whole steps that fit into the range: the counts don't depend on the float rounding of the accumulated sum
+    auto half_steps = [](float range, float counter) {
+        return counter > 0.0f ? (int)std::floor(range / counter + 0.5f) : 0;
+    };
+    glm::ivec3 steps(half_steps(x_range, x_counter), half_steps(y_range, y_counter), half_steps(z_range, z_counter));
+
+    std::vector<glm::vec3> positions;
+    RigGenerator::shakerGrid(positions, glm::vec3(x, y, z), steps, glm::vec3(x_counter, y_counter, z_counter));
+    addCameraRig(positions, dist);
+}
+
+void Photographer::addCameraRig(const std::vector<glm::vec3>& positions, float dist)
+{
+    image_cameras_.reserve(image_cameras_.size() + positions.size());
+    for (auto &&position : positions)
+    {
+        image_cameras_.add(createImageCamera_(position, dist));
+    }
+}
+
+Eigen::RowVector3d Photographer::getDefaultCameraPosition() const {
+    Eigen::RowVector3d ret;
+    ret(0) = default_camera_position_[0];
+    ret(1) = default_camera_position_[1];
+    ret(2) = default_camera_position_[2];
+
+    return ret;
+}
+
+Eigen::RowVector3d Photographer::getDefaultProjectPlaneNormal() const {
+    Eigen::RowVector3d ret;
+    ret(0) = default_camera_target_[0] - default_camera_position_[0];
+    ret(1) = default_camera_target_[1] - default_camera_position_[1];
+    ret(2) = default_camera_target_[2] - default_camera_position_[2];
+
+    return ret;
+}
+
+Eigen::RowVector3d Photographer::getCameraProjectPlaneNormal(int camera_idx) const {
+    if (camera_idx < 0 || camera_idx >= (int)image_cameras_.size()) {
+        return getDefaultProjectPlaneNormal();
+    }
+    const glm::vec3& direction = image_cameras_.viewDirections()[camera_idx];
+    return Eigen::RowVector3d(direction.x, direction.y, direction.z);
+}
+
+Eigen::MatrixXd Photographer::getCameraProjectPlaneNormals() const {
+    static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "view directions should be tightly packed");
+
+    const std::vector<glm::vec3>& directions = image_cameras_.viewDirections();
+    return Eigen::Map<const Eigen::Matrix<float, Eigen::Dynamic, 3, Eigen::RowMajor>>(
+        directions.empty() ? nullptr : &directions[0].x, directions.size(), 3).cast<double>();
+}
+
+void Photographer::setDefaultImageSize(int width, int height)
+{
+    if (width <= 0 || height <= 0)
+    {
+        std::cout << "WARNING::SET IMAGE SIZE::Invalid size " << width << "x" << height << ". Ignored" << std::endl;
+        return;
+    }
+    default_image_width_ = width;
+    default_image_height_ = height;
+}
+
+void Photographer::setCameraResolution(int camera_idx, int width, int height)
+{
+    if (camera_idx < 0 || camera_idx >= (int)image_cameras_.size())
+    {
+        std::cout << "ERROR::SET CAMERA RESOLUTION::No camera " << camera_idx << ". Ignored" << std::endl;
+        return;
+    }
+    image_cameras_.setResolution(camera_idx, width, height);
+}
+
+void Photographer::setCameraPrincipalPoint(int camera_idx, float cx, float cy)
+{
+    if (camera_idx < 0 || camera_idx >= (int)image_cameras_.size())
+    {
+        std::cout << "ERROR::SET CAMERA PRINCIPAL POINT::No camera " << camera_idx << ". Ignored" << std::endl;
+        return;
+    }
+    image_cameras_.setPrincipalPoint(camera_idx, cx, cy);
+}
+
+const CameraRig& Photographer::getImageCameras() const {
+    return image_cameras_;
+}
+
+bool Photographer::removeCamera(CameraRig::Handle camera)
+{
+    if (!image_cameras_.remove(camera))
+    {
+        std::cout << "WARNING::REMOVE CAMERA::The camera is already removed. Ignored" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void Photographer::clearCameras()
+{
+    image_cameras_.clear();
+}
+
+bool Photographer::openSession_()
+{
+    if (session_open_)
+    {
+        return true;
+    }
+    if (!initRenderContext_())
+    {
+        return false;
+    }
+
+    session_open_ = true;
+    return true;
+}
+
+void Photographer::closeSession_()
+{
+    if (!session_open_)
+    {
+        return;
+    }
+
+    // stays open if the context is taken by another thread
+    session_open_ = !cleanAndCloseContext_();
+}
+
+bool Photographer::initRenderContext_()
+{
+    if (!initWindowContext_(false))
+    {
+        return false;
+    }
+    layered_supported_ = hasGLExtension_("GL_ARB_shader_viewport_layer_array");
+
+    if (!setUpScene_())
+    {
+        cleanAndCloseContext_();
+        return false;
+    }
+
+    encoder_ = new ImageEncoderPool(encoder_threads_, encoder_queue_size_);
+
+    return true;
+}
+
+bool Photographer::setUpScene_()
+{
+    createShaders_();
+    createUniformBuffers_();
+    resetObjectTransform_();
+    bool uploaded = createTargetObjectVAO_();
+    createCameraObjectVAO_();
+    setUpTargetObjectColor_(*shader_);
+    setUpLight_();
+
+    // VAO is re-created on the next update
+    scene_object_ = uploaded ? object_ : nullptr;
+    scene_vertex_shader_type_ = vertex_shader_type_;
+    scene_fragment_shader_type_ = fragment_shader_type_;
+    return uploaded;
+}
+
+bool Photographer::updateScene_()
+{
+    // the session might be used from another thread than the one that opened it
+    if (!context_->makeCurrent())
+    {
+        std::cout << "ERROR::UPDATE SCENE::Failed to make the context current -- it might be current on another thread" 
+            << std::endl;
+        return false;
+    }
+
+    if (scene_object_ == object_
+        && scene_vertex_shader_type_ == vertex_shader_type_
+        && scene_fragment_shader_type_ == fragment_shader_type_)
+    {
+        return true;
+    }
+
+    if (scene_vertex_shader_type_ == vertex_shader_type_
+        && scene_fragment_shader_type_ == fragment_shader_type_)
+    {
+        // same layout -- only the data needs to be swapped
+        bool uploaded = uploadTargetObjectData_();
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+        scene_object_ = uploaded ? object_ : nullptr;
+        return uploaded;
+    }
+
+    // shading has changed since the upload
+    deleteTargetObjectVAO_();
+    createShaders_();
+    bool uploaded = createTargetObjectVAO_();
+    setUpTargetObjectColor_(*shader_);
+    setUpLight_();
+
+    scene_object_ = uploaded ? object_ : nullptr;
+    scene_vertex_shader_type_ = vertex_shader_type_;
+    scene_fragment_shader_type_ = fragment_shader_type_;
+    return uploaded;
+}
+
+bool Photographer::createTargetObjectVAO_()
+{
+    if (object_vertex_array_ > 0
+        || object_vertex_buffer_ > 0
+        || object_element_buffer_ > 0)
+    {
+        std::cout << "ERROR::CREATE OBJECT BUFFERS::OBJECT BUFFERS WERE ALREADY ALLOCATED. DATA IS LOST\n" << std::endl;
+    }
+
+    glGenVertexArrays(1, &object_vertex_array_);
+    glGenBuffers(1, &object_vertex_buffer_);
+    glGenBuffers(1, &object_element_buffer_);
+    if (vertex_shader_type_ == Shader::ShaderTypes::FACEIDX_SHADER
+        || vertex_shader_type_ == Shader::ShaderTypes::FLAT_SHADER)
+    {
+        glGenBuffers(1, &object_face_attribute_buffer_);
+        glGenTextures(1, &object_face_attribute_texture_);
+    }
+    if (vertex_shader_type_ == Shader::ShaderTypes::TEXTURE_SHADER)
+    {
+        glGenBuffers(1, &object_uv_buffer_);
+        glGenTextures(1, &object_vertex_texture_);
+        glGenTextures(1, &object_element_texture_);
+
+        glActiveTexture(GL_TEXTURE0);
+
+        glGenTextures(1, &object_texture_);
+
+        glBindTexture(GL_TEXTURE_2D, object_texture_);
+        float borderColor[] = { 1.0f, 1.0f, 0.0f, 1.0f };
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+
+    // leaves VAO and the element buffer bound
+    bool uploaded = uploadTargetObjectData_();
+
+    switch (vertex_shader_type_) {
+    case Shader::ShaderTypes::NOTEXTURE_SHADER:
+    case Shader::ShaderTypes::FACEIDX_SHADER:
+    case Shader::ShaderTypes::FLAT_SHADER:
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, object_vertex_buffer_);
+        // position
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GeneralMesh::GLMVertex), (void*)0);
+        glEnableVertexAttribArray(0);
+        if (vertex_shader_type_ == Shader::ShaderTypes::NOTEXTURE_SHADER)
+        {
+            // normals
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(GeneralMesh::GLMVertex),
+                (void*)offsetof(GeneralMesh::GLMVertex, GeneralMesh::GLMVertex::normal));
+            glEnableVertexAttribArray(1);
+        }
+        break; 
+    }
+    case Shader::ShaderTypes::TEXTURE_SHADER:
+    {
+        // position and normals are pulled by the shader, only uv comes per corner
+        glBindBuffer(GL_ARRAY_BUFFER, object_uv_buffer_);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)0);
+        glEnableVertexAttribArray(2);
+        break;
+    }
+    default:
+        break;
+    }
+    // Cleaning
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    return uploaded;
+}
+
+bool Photographer::uploadTargetObjectData_()
+{
+    // buffer storage is re-specified, VAO layout stays valid
+    glBindVertexArray(object_vertex_array_);
+
+    // shared by all the shaders
+    glBindBuffer(GL_ARRAY_BUFFER, object_vertex_buffer_);
+    glBufferData(GL_ARRAY_BUFFER,
+        object_->getGLNormalizedVertices().size() * sizeof(GeneralMesh::GLMVertex),
+        &object_->getGLNormalizedVertices()[0], GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, object_element_buffer_);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+        object_->getGLMFaces().size() * sizeof(unsigned int),
+        &object_->getGLMFaces()[0], GL_STATIC_DRAW);
+
+    switch (vertex_shader_type_) {
+    case Shader::ShaderTypes::TEXTURE_SHADER:
+    {
+        // views of the shared buffers for the vertex pulling
+        if (!checkBufferTextureSize_(object_->getGLNormalizedVertices().size() * sizeof(GeneralMesh::GLMVertex) / sizeof(float))
+            || !checkBufferTextureSize_(object_->getGLMFaces().size()))
+        {
+            return false;
+        }
+
+        const std::vector<GeneralMeshTexture::GLMVertexWithUV>& corners =
+            ((GeneralMeshTexture *)object_)->getGLNormalizedVerticesWithUV();
+        std::vector<glm::vec2> uvs;
+        uvs.reserve(corners.size());
+        for (auto &&corner : corners)
+        {
+            uvs.push_back(corner.uv);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, object_uv_buffer_);
+        glBufferData(GL_ARRAY_BUFFER, uvs.size() * sizeof(glm::vec2), &uvs[0], GL_STATIC_DRAW);
+
+        glBindTexture(GL_TEXTURE_BUFFER, object_vertex_texture_);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, object_vertex_buffer_);
+        glBindTexture(GL_TEXTURE_BUFFER, object_element_texture_);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, object_element_buffer_);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+        const GeneralMeshTexture::TextureInfo& tex = ((GeneralMeshTexture *)object_)->getTexInfo();
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, object_texture_);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, tex.width, tex.height, 0, GL_RGB, GL_UNSIGNED_BYTE, tex.data);
+        break;
+    }
+    case Shader::ShaderTypes::FACEIDX_SHADER:
+    {
+        return uploadFaceAttributes_(((GeneralMeshIdx *)object_)->getGLNormalizedVerticesWithId(),
+            &GeneralMeshIdx::GLMVertexWithId::faceid);
+    }
+    case Shader::ShaderTypes::FLAT_SHADER:
+    {
+        return uploadFaceAttributes_(((ParsingMesh*)object_)->getGLNormalizedVerticesWithColor(),
+            &ParsingMesh::GLMVertexWithColor::color);
+    }
+    default:
+        break;
+    }
+    return true;
+}
+
+template<typename VertexType>
+bool Photographer::uploadFaceAttributes_(const std::vector<VertexType>& per_corner, glm::vec3 VertexType::* attribute)
+{
+    // flat outputs used to come from the provoking vertex -- the last corner of the face.
+    // RGBA since RGB32F buffer textures are not in GL 3.3
+    std::vector<glm::vec4> per_face;
+    per_face.reserve(per_corner.size() / 3);
+    for (std::size_t corner = 2; corner < per_corner.size(); corner += 3)
+    {
+        per_face.push_back(glm::vec4(per_corner[corner].*attribute, 1.0f));
+    }
+    if (!checkBufferTextureSize_(per_face.size()))
+    {
+        return false;
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, object_face_attribute_buffer_);
+    glBufferData(GL_TEXTURE_BUFFER, per_face.size() * sizeof(glm::vec4), &per_face[0], GL_STATIC_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, object_face_attribute_texture_);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, object_face_attribute_buffer_);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    return true;
+}
+
+bool Photographer::checkBufferTextureSize_(std::size_t n_texels)
+{
+    GLint max_texels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &max_texels);
+    if (n_texels > (std::size_t)max_texels)
+    {
+        std::cout << "ERROR::UPLOAD OBJECT::OBJECT DATA (" << n_texels << " texels) EXCEEDS GL_MAX_TEXTURE_BUFFER_SIZE ("
+            << max_texels << "). NOTHING IS RENDERED" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void Photographer::prepareTargetObjectData_(GeneralMesh* object, Shader::ShaderTypes vertex_shader_type)
+{
+    // normalized GL representations are built by the mesh on the first request
+    object->getGLNormalizedVertices();
+    object->getGLMFaces();
+    switch (vertex_shader_type) {
+    case Shader::ShaderTypes::TEXTURE_SHADER:
+        ((GeneralMeshTexture *)object)->getGLNormalizedVerticesWithUV();
+        ((GeneralMeshTexture *)object)->getTexInfo();
+        break;
+    case Shader::ShaderTypes::FACEIDX_SHADER:
+        ((GeneralMeshIdx *)object)->getGLNormalizedVerticesWithId();
+        break;
+    case Shader::ShaderTypes::FLAT_SHADER:
+        ((ParsingMesh*)object)->getGLNormalizedVerticesWithColor();
+        break;
+    default:
+        break;
+    }
+    object->getFaces();
+}
+
+void Photographer::deleteTargetObjectVAO_()
+{
+    glDeleteVertexArrays(1, &object_vertex_array_);
+    glDeleteBuffers(1, &object_vertex_buffer_);
+    glDeleteBuffers(1, &object_element_buffer_);
+    object_vertex_array_ = object_element_buffer_ = object_vertex_buffer_ = 0;
+
+    // zeros are silently ignored
+    glDeleteBuffers(1, &object_face_attribute_buffer_);
+    glDeleteBuffers(1, &object_uv_buffer_);
+    glDeleteTextures(1, &object_face_attribute_texture_);
+    glDeleteTextures(1, &object_vertex_texture_);
+    glDeleteTextures(1, &object_element_texture_);
+    object_face_attribute_buffer_ = object_uv_buffer_ = 0;
+    object_face_attribute_texture_ = object_vertex_texture_ = object_element_texture_ = 0;
+
+    if (object_texture_)
+    {
+        glDeleteTextures(1, &object_texture_);
+        object_texture_ = 0;
+    }
+}
+
+void Photographer::createCameraObjectVAO_()
+{
+    if (cam_obj_vertex_array_ > 0
+        || cam_obj_vertex_buffer_ > 0
+        || cam_obj_element_buffer_ > 0)
+    {
+        std::cout << "ERROR::CREATE OBJECT BUFFERS::OBJECT BUFFERS WERE ALREADY ALLOCATED. DATA IS LOST\n" << std::endl;
+    }
+
+    glGenVertexArrays(1, &cam_obj_vertex_array_);
+    glBindVertexArray(cam_obj_vertex_array_);
+
+    glGenBuffers(1, &cam_obj_vertex_buffer_);
+    glBindBuffer(GL_ARRAY_BUFFER, cam_obj_vertex_buffer_);
+    glBufferData(GL_ARRAY_BUFFER, camera_model_verts_num_ * 3 * sizeof(float), 
+        camera_model_vertices_, GL_STATIC_DRAW);
+
+    glGenBuffers(1, &cam_obj_element_buffer_);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cam_obj_element_buffer_);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, camera_model_faces_num_ * 3 * sizeof(unsigned int),
+        camera_model_faces_, GL_STATIC_DRAW);
+
+    // Vertex data interpretation guide
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void Photographer::createShaders_()
+{
+    if (shader_ != nullptr) delete shader_;
+    shader_ = new Shader(vertex_shader_type_, fragment_shader_type_);
+    // simple_shader_ doesn't depend on the shader types, it's created by viewScene()
+
+    // re-created on demand with the new shader types
+    if (layered_shader_ != nullptr)
+    {
+        delete layered_shader_;
+        layered_shader_ = nullptr;
+    }
+}
+
+void Photographer::setUpTargetObjectColor_(Shader& shader)
+{
+    shader.use();
+
+    if (vertex_shader_type_ != Shader::NOTEXTURE_SHADER) {
+        shader.setUniform("Tex1", 0);
+    }
+    if (vertex_shader_type_ == Shader::TEXTURE_SHADER) {
+        shader.setUniform("vertices", vertex_texture_unit_);
+        shader.setUniform("faces", element_texture_unit_);
+    }
+    else if (vertex_shader_type_ == Shader::FACEIDX_SHADER || vertex_shader_type_ == Shader::FLAT_SHADER) {
+        shader.setUniform("face_attributes", face_attribute_texture_unit_);
+    }
+
+    // shared by all the programs
+    const Material& material = shading_params_.material;
+    MaterialBlock block = {};
+    block.shininess = material.shininess;
+    block.specular = material.specular;
+    block.diffuse = material.diffuse;
+    updateUniformBuffer_(material_uniform_buffer_, &block, sizeof(block));
+}
+
+void Photographer::setUpLight_()
+{
+    LightsBlock block = {};
+
+    // directional
+    const DirectionalLight& directional_light = shading_params_.directional_light;
+    block.directional_light.direction = directional_light.direction;
+    block.directional_light.ambient = directional_light.ambient;
+    block.directional_light.diffuse = directional_light.diffuse;
+    block.directional_light.specular = directional_light.specular;
+
+    // point lights
+    for (int i = 0; i < ShadingParams::kPointLights; ++i)
+    {
+        const PointLight& light = shading_params_.point_lights[i];
+        PointLightStd140& light_block = block.point_lights[i];
+
+        light_block.position = light.position;
+
+        light_block.ambient = light.ambient;
+        light_block.diffuse = light.diffuse;
+        light_block.specular = light.specular;
+
+        light_block.attenuation_constant = light.attenuation_constant;
+        light_block.attenuation_linear = light.attenuation_linear;
+        light_block.attenuation_quadratic = light.attenuation_quadratic;
+    }
+
+    updateUniformBuffer_(lights_uniform_buffer_, &block, sizeof(block));
+}
+
+void Photographer::createUniformBuffers_()
+{
+    if (camera_uniform_buffer_)
+    {
+        return;
+    }
+
+    const std::pair<unsigned int*, std::size_t> buffers[] = {
+        { &camera_uniform_buffer_, sizeof(CameraBlock) },
+        { &transform_uniform_buffer_, sizeof(TransformBlock) },
+        { &material_uniform_buffer_, sizeof(MaterialBlock) },
+        { &lights_uniform_buffer_, sizeof(LightsBlock) }
+    };
+    const Shader::UniformBlockBindings bindings[] = {
+        Shader::CAMERA_BINDING, Shader::TRANSFORM_BINDING, Shader::MATERIAL_BINDING, Shader::LIGHTS_BINDING
+    };
+    for (int i = 0; i < 4; ++i)
+    {
+        glGenBuffers(1, buffers[i].first);
+        glBindBuffer(GL_UNIFORM_BUFFER, *buffers[i].first);
+        glBufferData(GL_UNIFORM_BUFFER, buffers[i].second, NULL, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, bindings[i], *buffers[i].first);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void Photographer::deleteUniformBuffers_()
+{
+    unsigned int* buffers[] = {
+        &camera_uniform_buffer_, &transform_uniform_buffer_, &material_uniform_buffer_, &lights_uniform_buffer_
+    };
+    for (auto &&buffer : buffers)
+    {
+        if (*buffer)
+        {
+            glDeleteBuffers(1, buffer);
+            *buffer = 0;
+        }
+    }
+}
+
+void Photographer::resetObjectTransform_()
+{
+    TransformBlock transform;
+    transform.model = glm::mat4(1.0f);
+    transform.normal_matrix = glm::mat4(1.0f);
+    updateUniformBuffer_(transform_uniform_buffer_, &transform, sizeof(transform));
+}
+
+void Photographer::updateUniformBuffer_(unsigned int buffer, const void* data, std::size_t size)
+{
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+Camera Photographer::createImageCamera_(glm::vec3 position, float dist)
+{
+    if (dist > 0.0)
+    {
+        position = dist * glm::normalize(position - default_camera_target_);
+    }
+
+    Camera camera(default_image_width_, default_image_height_);
+    camera.setPose(position, default_camera_target_);
+    return camera;
+}
+
+Camera Photographer::createDefaultTargetCamera_()
+{
+    Camera camera(default_image_width_, default_image_height_);
+    camera.setPosition(default_camera_position_);
+    camera.setTarget(default_camera_target_);
+    camera.setID(0);
+    return camera;
+}
+
+void Photographer::clearBackground_()
+{
+    //glClearColor(0.85f, 0.8f, 0.8f, 1.0f);   // state-setting function
+    //glClearColor(0.2f, 0.2f, 3.0f, 1.0f);   // state-setting function
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);   // state-setting function
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);       // state-using function
+}
+
+void Photographer::cameraParamsToUniforms_(const Camera& camera)
+{
+    CameraBlock block;
+    block.view = camera.getGlViewMatrix();
+    block.projection = camera.getGlProjectionMatrix();
+    block.eye_pos = glm::vec4(camera.getPosition(), 1.0f);
+    updateUniformBuffer_(camera_uniform_buffer_, &block, sizeof(block));
+}
+
+void Photographer::drawMainObject_(Shader& shader, int n_instances)
+{
+    shader.use();
+    glBindVertexArray(this->object_vertex_array_);
+
+    // the object stays in its own coordinates -- identity transform is in the buffer, see resetObjectTransform_()
+
+    switch (vertex_shader_type_) {
+    case Shader::TEXTURE_SHADER:
+        // corners are not shared because of the uv seams -- one vertex per corner, the rest is pulled by the index
+        glActiveTexture(GL_TEXTURE0 + vertex_texture_unit_);
+        glBindTexture(GL_TEXTURE_BUFFER, object_vertex_texture_);
+        glActiveTexture(GL_TEXTURE0 + element_texture_unit_);
+        glBindTexture(GL_TEXTURE_BUFFER, object_element_texture_);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, object_texture_);
+
+        glDrawArraysInstanced(GL_TRIANGLES, 0, (object_)->getFaces().size(), n_instances);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        break;
+    case Shader::FACEIDX_SHADER:
+    case Shader::FLAT_SHADER:
+        glActiveTexture(GL_TEXTURE0 + face_attribute_texture_unit_);
+        glBindTexture(GL_TEXTURE_BUFFER, object_face_attribute_texture_);
+        glActiveTexture(GL_TEXTURE0);
+
+        glDrawElementsInstanced(GL_TRIANGLES, object_->getFaces().size(), GL_UNSIGNED_INT, 0, n_instances);
+        break;
+    default:
+        glDrawElementsInstanced(GL_TRIANGLES, object_->getFaces().size(), GL_UNSIGNED_INT, 0, n_instances);
+        break;
+    }
+
+    glBindVertexArray(0);
+}
+
+void Photographer::drawLayeredPass_(std::size_t first_camera, std::size_t n_cameras)
+{
+    LayeredCamerasBlock cameras;
+    Camera::getRigMatrices(&image_cameras_[first_camera], n_cameras, cameras.views, cameras.projections, cameras.eye_positions);
+    updateUniformBuffer_(layered_cameras_buffer_, &cameras, sizeof(LayeredCamerasBlock));
+
+    // clears all the layers at once
+    glBindFramebuffer(GL_FRAMEBUFFER, layered_framebuffer_);
+    glViewport(0, 0, layered_buffer_size_.first, layered_buffer_size_.second);
+    clearBackground_();
+    drawMainObject_(*layered_shader_, (int)n_cameras);
+}
+
+void Photographer::drawImageCameraObjects_(Shader & shader)
+{
+    shader.use();
+    glBindVertexArray(this->cam_obj_vertex_array_);
+
+    // the camera model looks along x
+    const glm::mat4 turn_y_90 = glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    TransformBlock transform;
+    for (auto &&camera : image_cameras_)
+    {
+        transform.model = camera.getGlCameraToWorldMatrix() * turn_y_90;
+        // rigid transform: the rotation part is its own inverse transpose
+        transform.normal_matrix = glm::mat4(glm::mat3(transform.model));
+        updateUniformBuffer_(transform_uniform_buffer_, &transform, sizeof(transform));
+        glDrawElements(GL_TRIANGLES, camera_model_faces_num_ * 3, GL_UNSIGNED_INT, 0); 
+    }
+    resetObjectTransform_();
+
+    glBindVertexArray(0);
+}
+
+bool Photographer::initWindowContext_(bool visible)
+{
+    // only GLFW can show the window
+    ContextBackend::BackendTypes backend_type = visible ? ContextBackend::GLFW_BACKEND : context_backend_type_;
+
+    context_ = ContextBackend::create(backend_type);
+    if (context_ == nullptr || !context_->init(win_width_, win_height_, visible))
+    {
+        delete context_;
+        context_ = nullptr;
+        return false;
+    }
+
+    // load glad
+    if (!context_->loadGL())
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        context_->terminate();
+        delete context_;
+        context_ = nullptr;
+        return false;
+    }
+
+    // set viewport size -- viewport is needed to calc screen coordinates from normalized range
+    glViewport(0, 0, win_width_, win_height_);
+
+    glEnable(GL_CULL_FACE);
+    glEnable(GL_DEPTH_TEST);
+
+    // TUTORIAL for a mouse control
+    GLFWwindow* window = context_->getWindow();
+    if (window != nullptr)
+    {
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    }
+
+    return true;
+}
+
+Photographer::RenderTarget& Photographer::initRenderTarget_(ImageSize size, bool face_idx, bool multisample)
+{
+    RenderTarget& target = render_targets_[size];
+    if (!target.framebuffer)
+    {
+        target.width = size.first;
+        target.height = size.second;
+
+        glGenFramebuffers(1, &target.framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+
+        glGenTextures(1, &target.color_buffer);
+        glBindTexture(GL_TEXTURE_2D, target.color_buffer);
+        // dimention should match current Viewport dimentions (call glViewport if the change is needed)
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, target.width, target.height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        // attach to framebuffer
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.color_buffer, 0);
+
+        glGenRenderbuffers(1, &target.depth_buffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, target.depth_buffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, target.width, target.height);
+
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, target.depth_buffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cout << "ERROR::RenderToImage:: Framebuffer " << target.width << "x" << target.height 
+                << " is not complete!" << std::endl;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // the rest follows the outputs of the current render
+    if (depth_export_)
+    {
+        initDepthExport_(target);
+    }
+    initFaceIndexExport_(target, face_idx);
+    if (multisample)
+    {
+        initMultisampling_(target);
+    }
+
+    return target;
+}
+
+Photographer::RenderTarget& Photographer::renderTarget_(const Camera& camera, bool face_idx, bool multisample)
+{
+    auto found = render_targets_.find(ImageSize(camera.getWidth(), camera.getHeight()));
+    if (found != render_targets_.end())
+    {
+        return found->second;
+    }
+    // the camera has been resized since the targets were set up
+    return initRenderTarget_(ImageSize(camera.getWidth(), camera.getHeight()), face_idx, multisample);
+}
+
+void Photographer::deleteRenderTargets_()
+{
+    for (auto &&entry : render_targets_)
+    {
+        RenderTarget& target = entry.second;
+        deleteMultisampling_(target);
+        glDeleteFramebuffers(1, &target.framebuffer);
+        glDeleteTextures(1, &target.color_buffer);
+        glDeleteRenderbuffers(1, &target.depth_buffer);
+        if (target.depth_texture)
+        {
+            glDeleteTextures(1, &target.depth_texture);
+        }
+        if (target.face_idx_buffer)
+        {
+            glDeleteTextures(1, &target.face_idx_buffer);
+        }
+    }
+    render_targets_.clear();
+
+    if (multisample_resolve_shader_ != nullptr)
+    {
+        delete multisample_resolve_shader_;
+        multisample_resolve_shader_ = nullptr;
+    }
+    if (multisample_vertex_array_)
+    {
+        glDeleteVertexArrays(1, &multisample_vertex_array_);
+        multisample_vertex_array_ = 0;
+    }
+}
+
+std::vector<Photographer::ImageSize> Photographer::imageSizes_() const
+{
+    std::vector<ImageSize> sizes;
+    for (auto &&camera : image_cameras_)
+    {
+        ImageSize size(camera.getWidth(), camera.getHeight());
+        if (std::find(sizes.begin(), sizes.end(), size) == sizes.end())
+        {
+            sizes.push_back(size);
+        }
+    }
+    return sizes;
+}
+
+bool Photographer::cleanAndCloseContext_()
+{
+    // GL objects belong to this instance's context
+    if (context_ != nullptr && !context_->makeCurrent())
+    {
+        std::cout << "ERROR::CLEAN UP::Failed to make the context current -- it might be current on another thread. "
+            << "Nothing is released" << std::endl;
+        return false;
+    }
+
+    // object-related. Should always be there
+    deleteTargetObjectVAO_();
+
+    // camera
+    glDeleteVertexArrays(1, &cam_obj_vertex_array_);
+    glDeleteBuffers(1, &cam_obj_vertex_buffer_);
+    glDeleteBuffers(1, &cam_obj_element_buffer_);
+    cam_obj_vertex_array_ = cam_obj_vertex_buffer_ = cam_obj_element_buffer_ = 0;
+
+    deleteRenderTargets_();
+    deleteReadbackBuffers_();
+    deleteLayeredRendering_();
+    layered_supported_ = false;
+    deleteAtlasBuffers_();
+    deleteFaceVisibility_();
+    deleteUniformBuffers_();
+
+    if (shader_ != nullptr)
+    {
+        delete shader_;
+        shader_ = nullptr;
+    }
+
+    if (simple_shader_ != nullptr)
+    {
+        delete simple_shader_;
+        simple_shader_ = nullptr;
+    }
+    
+    if (view_camera_ != nullptr)
+    {
+        delete view_camera_;
+        view_camera_ = nullptr;
+    }
+
+    if (encoder_ != nullptr)
+    {
+        delete encoder_;
+        encoder_ = nullptr;
+    }
+    scene_object_ = nullptr;
+
+    if (context_ != nullptr)
+    {
+        context_->terminate();
+        delete context_;
+        context_ = nullptr;
+    }
+    return true;
+}
+
+bool Photographer::initLayeredRendering_(ImageSize size)
+{
+    if (!layered_supported_ || vertex_shader_type_ == Shader::DEFAULT_SHADER)
+    {
+        std::cout << "WARNING::LAYERED RENDERING::Not available (requires GL_ARB_shader_viewport_layer_array "
+            << "and non-default shader). Cameras are rendered one by one" << std::endl;
+        return false;
+    }
+
+    if (layered_shader_ == nullptr)
+    {
+        layered_shader_ = new Shader(vertex_shader_type_, fragment_shader_type_, true);
+        if (!layered_shader_->isLinked())
+        {
+            std::cout << "ERROR::LAYERED RENDERING::Failed to build the layered shader. Cameras are rendered one by one" << std::endl;
+            deleteLayeredRendering_();
+            layered_supported_ = false;
+            return false;
+        }
+        // blocks are bound at link time, only the samplers are per program
+        setUpTargetObjectColor_(*layered_shader_);
+    }
+
+    if (!layered_cameras_buffer_)
+    {
+        glGenBuffers(1, &layered_cameras_buffer_);
+        glBindBuffer(GL_UNIFORM_BUFFER, layered_cameras_buffer_);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(LayeredCamerasBlock), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+    glBindBufferBase(GL_UNIFORM_BUFFER, Shader::LAYERED_CAMERAS_BINDING, layered_cameras_buffer_);
+
+    if (layered_buffer_layers_ == cameras_per_pass_ && layered_buffer_size_ == size)
+    {
+        return true;
+    }
+
+    // all attachments of a layered framebuffer should be layered
+    if (layered_color_buffer_) glDeleteTextures(1, &layered_color_buffer_);
+    if (layered_depth_buffer_) glDeleteTextures(1, &layered_depth_buffer_);
+    if (!layered_framebuffer_) glGenFramebuffers(1, &layered_framebuffer_);
+    if (!layer_read_framebuffer_) glGenFramebuffers(1, &layer_read_framebuffer_);
+
+    glGenTextures(1, &layered_color_buffer_);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, layered_color_buffer_);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGB, size.first, size.second, cameras_per_pass_, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenTextures(1, &layered_depth_buffer_);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, layered_depth_buffer_);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH24_STENCIL8, size.first, size.second, cameras_per_pass_, 0, 
+        GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, layered_framebuffer_);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, layered_color_buffer_, 0);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, layered_depth_buffer_, 0);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (!complete)
+    {
+        std::cout << "ERROR::LAYERED RENDERING::Layered framebuffer is not complete! Cameras are rendered one by one" << std::endl;
+        deleteLayeredRendering_();
+        layered_supported_ = false;
+        return false;
+    }
+    layered_buffer_layers_ = cameras_per_pass_;
+    layered_buffer_size_ = size;
+
+    return true;
+}
+
+void Photographer::deleteLayeredRendering_()
+{
+    if (layered_shader_ != nullptr)
+    {
+        delete layered_shader_;
+        layered_shader_ = nullptr;
+    }
+    if (layered_cameras_buffer_)
+    {
+        glDeleteBuffers(1, &layered_cameras_buffer_);
+        layered_cameras_buffer_ = 0;
+    }
+    if (layered_framebuffer_)
+    {
+        glDeleteFramebuffers(1, &layered_framebuffer_);
+        layered_framebuffer_ = 0;
+    }
+    if (layer_read_framebuffer_)
+    {
+        glDeleteFramebuffers(1, &layer_read_framebuffer_);
+        layer_read_framebuffer_ = 0;
+    }
+    if (layered_color_buffer_)
+    {
+        glDeleteTextures(1, &layered_color_buffer_);
+        layered_color_buffer_ = 0;
+    }
+    if (layered_depth_buffer_)
+    {
+        glDeleteTextures(1, &layered_depth_buffer_);
+        layered_depth_buffer_ = 0;
+    }
+    layered_buffer_layers_ = 0;
+    layered_buffer_size_ = ImageSize();
+}
+
+bool Photographer::hasGLExtension_(const char* name)
+{
+    GLint n_extensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &n_extensions);
+    for (GLint i = 0; i < n_extensions; ++i)
+    {
+        const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if (extension != nullptr && std::strcmp(extension, name) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Photographer::initAtlasBuffers_(ImageSize tile_size)
+{
+    // the atlas is limited by GL and by the memory the readback is allowed to take
+    GLint max_texture_size = 0, max_renderbuffer_size = 0;
+    GLint max_viewport_dims[2] = { 0, 0 };
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+    glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &max_renderbuffer_size);
+    glGetIntegerv(GL_MAX_VIEWPORT_DIMS, max_viewport_dims);
+    int max_width = std::min({ (int)max_texture_size, (int)max_renderbuffer_size, (int)max_viewport_dims[0], atlas_max_size_ });
+    int max_height = std::min({ (int)max_texture_size, (int)max_renderbuffer_size, (int)max_viewport_dims[1], atlas_max_size_ });
+
+    int tile_width = tile_size.first;
+    int tile_height = tile_size.second;
+    std::size_t max_columns = max_width / tile_width;
+    std::size_t max_rows = max_height / tile_height;
+    if (max_columns * max_rows < 2)
+    {
+        std::cout << "WARNING::ATLAS RENDERING::At most one " << tile_width << "x" << tile_height 
+            << " camera fits into the atlas. Cameras are rendered one by one" << std::endl;
+        return false;
+    }
+
+    // close to square, no larger than needed
+    std::size_t tiles = std::min(image_cameras_.size(), max_columns * max_rows);
+    std::size_t columns = std::min(max_columns, (std::size_t)std::ceil(std::sqrt((double)tiles)));
+    std::size_t rows = (tiles + columns - 1) / columns;
+    if (rows > max_rows)
+    {
+        rows = max_rows;
+        columns = (tiles + rows - 1) / rows;
+    }
+
+    atlas_tile_width_ = tile_width;
+    atlas_tile_height_ = tile_height;
+    atlas_columns_ = columns;
+    atlas_tiles_ = tiles;
+    int width = (int)columns * tile_width;
+    int height = (int)rows * tile_height;
+    if (atlas_framebuffer_ && width == atlas_width_ && height == atlas_height_)
+    {
+        return true;
+    }
+
+    deleteAtlasBuffers_();
+    atlas_width_ = width;
+    atlas_height_ = height;
+
+    glGenFramebuffers(1, &atlas_framebuffer_);
+    glBindFramebuffer(GL_FRAMEBUFFER, atlas_framebuffer_);
+
+    glGenTextures(1, &atlas_color_buffer_);
+    glBindTexture(GL_TEXTURE_2D, atlas_color_buffer_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, atlas_width_, atlas_height_, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, atlas_color_buffer_, 0);
+
+    glGenRenderbuffers(1, &atlas_depth_buffer_);
+    glBindRenderbuffer(GL_RENDERBUFFER, atlas_depth_buffer_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, atlas_width_, atlas_height_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, atlas_depth_buffer_);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete)
+    {
+        std::cout << "ERROR::ATLAS RENDERING::Atlas framebuffer is not complete! Cameras are rendered one by one" << std::endl;
+        deleteAtlasBuffers_();
+        return false;
+    }
+
+    std::size_t buffer_size = (std::size_t)atlas_width_ * (std::size_t)atlas_height_ * 3;
+    glGenBuffers(readback_ring_size_, atlas_readback_buffers_);
+    for (std::size_t slot = 0; slot < readback_ring_size_; ++slot)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, atlas_readback_buffers_[slot]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, buffer_size, NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    return true;
+}
+
+void Photographer::deleteAtlasBuffers_()
+{
+    if (atlas_framebuffer_)
+    {
+        glDeleteFramebuffers(1, &atlas_framebuffer_);
+        atlas_framebuffer_ = 0;
+    }
+    if (atlas_color_buffer_)
+    {
+        glDeleteTextures(1, &atlas_color_buffer_);
+        atlas_color_buffer_ = 0;
+    }
+    if (atlas_depth_buffer_)
+    {
+        glDeleteRenderbuffers(1, &atlas_depth_buffer_);
+        atlas_depth_buffer_ = 0;
+    }
+    for (std::size_t slot = 0; slot < readback_ring_size_; ++slot)
+    {
+        if (atlas_readback_fences_[slot] != nullptr)
+        {
+            glDeleteSync(atlas_readback_fences_[slot]);
+            atlas_readback_fences_[slot] = nullptr;
+        }
+        if (atlas_readback_buffers_[slot])
+        {
+            glDeleteBuffers(1, &atlas_readback_buffers_[slot]);
+            atlas_readback_buffers_[slot] = 0;
+        }
+    }
+    atlas_width_ = atlas_height_ = 0;
+}
+
+void Photographer::finishAtlasReadback_(std::size_t slot, const std::vector<unsigned int>& camera_ids, bool owned_frames,
+    const FrameSink& sink, ImageEncoderPool& encoder)
+{
+    GLenum wait_status = GL_TIMEOUT_EXPIRED;
+    while (wait_status == GL_TIMEOUT_EXPIRED)
+    {
+        wait_status = glClientWaitSync(atlas_readback_fences_[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);  // 1 sec in ns
+    }
+    glDeleteSync(atlas_readback_fences_[slot]);
+    atlas_readback_fences_[slot] = nullptr;
+
+    if (wait_status == GL_WAIT_FAILED)
+    {
+        std::cout << "ERROR::RenderToImage::Waiting for the atlas transfer failed. Skipping "
+            << camera_ids.size() << " images" << std::endl;
+        return;
+    }
+
+    std::size_t atlas_size = (std::size_t)atlas_width_ * atlas_height_ * 3;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, atlas_readback_buffers_[slot]);
+    void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, atlas_size, GL_MAP_READ_BIT);
+    if (pixels == nullptr)
+    {
+        std::cout << "ERROR::RenderToImage::Failed to map the atlas pixel buffer. Skipping "
+            << camera_ids.size() << " images" << std::endl;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        return;
+    }
+
+    const unsigned char* atlas_pixels = (const unsigned char*)pixels;
+    ImageEncoderPool::PixelBuffer atlas;
+    if (owned_frames)
+    {
+        // the only copy: frames of the tiles share the atlas
+        atlas = encoder.acquireBuffer(atlas_size);
+        std::memcpy(atlas->data(), pixels, atlas_size);
+        atlas_pixels = atlas->data();
+
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    int tile_width = atlas_tile_width_;
+    int tile_height = atlas_tile_height_;
+    int stride = atlas_width_ * 3;
+    for (std::size_t tile = 0; tile < camera_ids.size(); ++tile)
+    {
+        // rows are bottom-up, just like in GL
+        std::size_t offset = ((tile / atlas_columns_) * tile_height * (std::size_t)atlas_width_
+            + (tile % atlas_columns_) * tile_width) * 3;
+        Frame frame;
+        frame.view = rgbImageView_(atlas_pixels + offset, tile_width, tile_height, stride, camera_ids[tile]);
+        frame.pixels = atlas;
+        sink(frame, encoder);
+    }
+
+    if (!owned_frames)
+    {
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+}
+
+void Photographer::initReadbackBuffers_(std::size_t n_pixels)
+{
+    reserveReadbackBuffers_(readback_buffers_, readback_buffer_size_, n_pixels * 3);
+    if (depth_export_)
+    {
+        reserveReadbackBuffers_(depth_readback_buffers_, depth_readback_buffer_size_, n_pixels * sizeof(float));
+    }
+    if (face_idx_export_)
+    {
+        reserveReadbackBuffers_(face_idx_readback_buffers_, face_idx_readback_buffer_size_, n_pixels * sizeof(unsigned int));
+    }
+}
+
+void Photographer::reserveReadbackBuffers_(unsigned int* buffers, std::size_t& reserved_size, std::size_t size)
+{
+    // smaller images reuse the larger buffers
+    if (buffers[0] && reserved_size >= size)
+    {
+        return;
+    }
+
+    for (std::size_t slot = 0; slot < readback_ring_size_; ++slot)
+    {
+        if (!buffers[slot])
+        {
+            glGenBuffers(1, &buffers[slot]);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[slot]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    reserved_size = size;
+}
+
+void Photographer::deleteReadbackBuffers_()
+{
+    for (std::size_t slot = 0; slot < readback_ring_size_; ++slot)
+    {
+        if (readback_fences_[slot] != nullptr)
+        {
+            glDeleteSync(readback_fences_[slot]);
+            readback_fences_[slot] = nullptr;
+        }
+        unsigned int buffers[3] = { readback_buffers_[slot], depth_readback_buffers_[slot], face_idx_readback_buffers_[slot] };
+        glDeleteBuffers(3, buffers);    // zeros are ignored
+        readback_buffers_[slot] = depth_readback_buffers_[slot] = face_idx_readback_buffers_[slot] = 0;
+    }
+    readback_buffer_size_ = depth_readback_buffer_size_ = face_idx_readback_buffer_size_ = 0;
+}
+
+void Photographer::startReadback_(std::size_t slot, int width, int height)
+{
+    // reads from the currently bound framebuffer into the pixel buffer -- returns immediately
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback_buffers_[slot]);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, 0);
+    if (depth_export_)
+    {
+        // same pass, same fence
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, depth_readback_buffers_[slot]);
+        glReadPixels(0, 0, width, height, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
+    }
+    if (face_idx_export_)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, face_idx_readback_buffers_[slot]);
+        glReadBuffer(GL_COLOR_ATTACHMENT1);
+        glReadPixels(0, 0, width, height, GL_RED_INTEGER, GL_UNSIGNED_INT, 0);
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    readback_fences_[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void Photographer::finishReadback_(std::size_t slot, const Camera& camera, bool owned_frames,
+    const FrameSink& sink, ImageEncoderPool& encoder)
+{
+    unsigned int camera_id = camera.getID();
+
+    // wait for the transfer to complete
+    GLenum wait_status = GL_TIMEOUT_EXPIRED;
+    while (wait_status == GL_TIMEOUT_EXPIRED)
+    {
+        wait_status = glClientWaitSync(readback_fences_[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);  // 1 sec in ns
+    }
+    glDeleteSync(readback_fences_[slot]);
+    readback_fences_[slot] = nullptr;
+
+    if (wait_status == GL_WAIT_FAILED)
+    {
+        std::cout << "ERROR::RenderToImage::Waiting for the pixel transfer failed. Skipping camera "
+            << camera_id << std::endl;
+        return;
+    }
+
+    int width = camera.getWidth();
+    int height = camera.getHeight();
+    std::size_t image_size = (std::size_t)width * height * 3;
+
+    Frame frame;
+    if (depth_export_)
+    {
+        // linearized on the way out of the mapped buffer
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, depth_readback_buffers_[slot]);
+        const float* window_depth = (const float*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, 
+            (std::size_t)width * height * sizeof(float), GL_MAP_READ_BIT);
+        if (window_depth != nullptr)
+        {
+            setFrameDepth_(frame, window_depth, camera, width, height, encoder);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        else
+        {
+            std::cout << "ERROR::RenderToImage::Failed to map the depth buffer. No depth for camera "
+                << camera_id << std::endl;
+        }
+    }
+    if (face_idx_export_)
+    {
+        ImageEncoderPool::PixelBuffer face_idx = copyReadbackBuffer_(face_idx_readback_buffers_[slot],
+            (std::size_t)width * height * sizeof(unsigned int), encoder);
+        if (face_idx)
+        {
+            frame.face_idx = scalarImageView_(face_idx->data(), width, height, camera_id);
+            frame.face_idx_pixels = std::move(face_idx);
+        }
+        else
+        {
+            std::cout << "ERROR::RenderToImage::Failed to map the face index buffer. No face indices for camera "
+                << camera_id << std::endl;
+        }
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback_buffers_[slot]);
+    void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, image_size, GL_MAP_READ_BIT);
+    if (pixels == nullptr)
+    {
+        std::cout << "ERROR::RenderToImage::Failed to map the pixel buffer. Skipping camera "
+            << camera_id << std::endl;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        return;
     }
 
-    glGenVertexArrays(1, &cam_obj_vertex_array_);
-    glBindVertexArray(cam_obj_vertex_array_);
+    if (!owned_frames)
+    {
+        // borrowed right from the mapped memory -- no copy at all
+        frame.view = rgbImageView_((const unsigned char*)pixels, width, height, width * 3, camera_id);
+        sink(frame, encoder);
 
-    glGenBuffers(1, &cam_obj_vertex_buffer_);
-    glBindBuffer(GL_ARRAY_BUFFER, cam_obj_vertex_buffer_);
-    glBufferData(GL_ARRAY_BUFFER, camera_model_verts_num_ * 3 * sizeof(float), 
-        camera_model_vertices_, GL_STATIC_DRAW);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        return;
+    }
 
-    glGenBuffers(1, &cam_obj_element_buffer_);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, cam_obj_element_buffer_);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, camera_model_faces_num_ * 3 * sizeof(unsigned int),
-        camera_model_faces_, GL_STATIC_DRAW);
+    // the mapping should be released asap, so the frame gets its own copy
+    ImageEncoderPool::PixelBuffer image = encoder.acquireBuffer(image_size);
+    std::memcpy(image->data(), pixels, image_size);
 
-    // Vertex data interpretation guide
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
 
-    glBindVertexArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    frame.view = rgbImageView_(image->data(), width, height, width * 3, camera_id);
+    frame.pixels = std::move(image);
+    sink(frame, encoder);
 }
 
-void Photographer::createShaders_()
+ImageView Photographer::rgbImageView_(const unsigned char* data, int width, int height, int stride, unsigned int camera_id)
 {
-    if (shader_ != nullptr) delete shader_;
-    shader_ = new Shader(vertex_shader_type_, fragment_shader_type_);
-
-    if (simple_shader_ != nullptr) delete simple_shader_;
-    simple_shader_ = new Shader(Shader::NOTEXTURE_SHADER, Shader::DEFAULT_SHADER);   // use default fragment shader
-
+    ImageView view;
+    view.data = data;
+    view.width = width;
+    view.height = height;
+    view.channels = 3;
+    view.stride = stride;
+    view.camera_id = camera_id;
+    return view;
 }
 
-void Photographer::setUpTargetObjectColor_()
+void Photographer::initDepthExport_(RenderTarget& target)
 {
-    shader_->use();
-
-    //glm::vec3 color = glm::vec3(1.0f, 0.5f, 0.31f);  coral
-    glm::vec3 color = glm::vec3(0.6f, 0.6f, 0.6f);
-
-    if (vertex_shader_type_ != Shader::NOTEXTURE_SHADER) {
-        shader_->setUniform("Tex1", 0);
+    if (target.depth_texture)
+    {
+        return;
     }
 
-    shader_->setUniform("material.diffuse", color);
-    shader_->setUniform("material.specular", 0.3f * color);
-    shader_->setUniform("material.shininess", 64.0f);
+    glGenTextures(1, &target.depth_texture);
+    glBindTexture(GL_TEXTURE_2D, target.depth_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, target.width, target.height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // replaces the depth-stencil renderbuffer -- stencil is not used anyway
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, target.depth_texture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cout << "ERROR::RenderToImage:: Framebuffer with the depth texture is not complete!" << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-void Photographer::setUpLight_()
+void Photographer::setFrameDepth_(Frame& frame, const float* window_depth, const Camera& camera, int width, int height,
+    ImageEncoderPool& encoder)
 {
-    // directional
-    shader_->setUniform("directional_light.direction", glm::vec3(-0.2f, -1.0f, -0.5f));
-    shader_->setUniform("directional_light.ambient", glm::vec3(0.2f));
-    shader_->setUniform("directional_light.diffuse", glm::vec3(0.7f, 0.7f, 0.7f));
-    shader_->setUniform("directional_light.specular", glm::vec3(1.0f, 1.0f, 1.0f));
-
-    static const std::size_t kPointLights = 2;
-    glm::vec3 point_light_positions[kPointLights] = {
-        glm::vec3(0.7f,  0.2f,  2.0f),
-        glm::vec3(0.0f,  0.0f, -2.0f)
-    };
-
-    // point lights
-    for (int i = 0; i < kPointLights; ++i)
+    std::size_t n_pixels = (std::size_t)width * height;
+    ImageEncoderPool::PixelBuffer depth = encoder.acquireBuffer(n_pixels * sizeof(float));
+    float* metric_depth = (float*)depth->data();
+
+    // inverse of the GL perspective projection: window => NDC => distance along the view axis
+    float near_plane = camera.getNearPlane();
+    float far_plane = camera.getFarPlane();
+    for (std::size_t i = 0; i < n_pixels; ++i)
     {
-        std::string name = "point_lights[";
-        name += std::to_string(i) + ']';
-
-        shader_->setUniform(name + ".position", point_light_positions[i]);
-
-        shader_->setUniform(name + ".ambient", glm::vec3(0.2f));
-        shader_->setUniform(name + ".diffuse", glm::vec3(0.5f, 0.5f, 0.5f));
-        shader_->setUniform(name + ".specular", glm::vec3(1.0f, 1.0f, 1.0f));
-
-        shader_->setUniform(name + ".attenuation_constant", 1.0f);
-        shader_->setUniform(name + ".attenuation_linear", 0.09f);
-        shader_->setUniform(name + ".attenuation_quadratic", 0.032f);
+        float ndc_z = 2.0f * window_depth[i] - 1.0f;
+        metric_depth[i] = window_depth[i] < 1.0f
+            ? 2.0f * near_plane * far_plane / (far_plane + near_plane - ndc_z * (far_plane - near_plane))
+            : 0.0f;   // background
     }
+
+    frame.depth = scalarImageView_(depth->data(), width, height, camera.getID());
+    frame.depth_pixels = std::move(depth);
 }
 
-Camera Photographer::createDefaultTargetCamera_()
+int Photographer::saveDepthToFile_(const std::string filename, DepthFormats format, float png_depth_scale, 
+    int png_compression_level, const ImageView& depth)
 {
-    Camera camera(win_width_, win_height_);
-    camera.setPosition(default_camera_position_);
-    camera.setTarget(default_camera_target_);
-    camera.setID(0);
-    return camera;
+    switch (format)
+    {
+    case DEPTH_PNG16:
+    {
+        std::vector<unsigned short> scaled = scaledDepth16_(depth, png_depth_scale);
+        return ImageWriter::writePNG16(filename, depth.width, depth.height, scaled.data(), depth.width * sizeof(unsigned short),
+            png_compression_level);
+    }
+    case DEPTH_PGM16:
+    {
+        std::vector<unsigned short> scaled = scaledDepth16_(depth, png_depth_scale);
+        return ImageWriter::writePGM16(filename, depth.width, depth.height, scaled.data(), depth.width * sizeof(unsigned short));
+    }
+    case DEPTH_FLOAT_RAW:
+        return ImageWriter::writeFloatRaw(filename, depth.width, depth.height, (const float*)depth.data, depth.stride);
+    case DEPTH_RAW:
+        return ImageWriter::writeRaw(filename, depth.width, depth.height, 1, ImageWriter::RAW_FLOAT32, depth.data, depth.stride);
+    case DEPTH_NPY:
+    default:
+        return ImageWriter::writeFloatNpy(filename, depth.width, depth.height, (const float*)depth.data, depth.stride);
+    }
 }
 
-void Photographer::clearBackground_()
+std::vector<unsigned short> Photographer::scaledDepth16_(const ImageView& depth, float png_depth_scale)
 {
-    //glClearColor(0.85f, 0.8f, 0.8f, 1.0f);   // state-setting function
-    //glClearColor(0.2f, 0.2f, 3.0f, 1.0f);   // state-setting function
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);   // state-setting function
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);       // state-using function
+    std::vector<unsigned short> scaled((std::size_t)depth.width * depth.height);
+    for (int y = 0; y < depth.height; ++y)
+    {
+        const float* row = (const float*)depth.row(y);
+        for (int x = 0; x < depth.width; ++x)
+        {
+            scaled[(std::size_t)y * depth.width + x] = (unsigned short)std::min(row[x] * png_depth_scale + 0.5f, 65535.0f);
+        }
+    }
+    return scaled;
 }
 
-void Photographer::cameraParamsToShader_(Shader& shader, Camera& camera)
+const char* Photographer::depthFileExtension_(DepthFormats format)
 {
-    shader.use();
-    shader.setUniform("view", camera.getGlViewMatrix());
-    shader.setUniform("projection", camera.getGlProjectionMatrix());
-    shader.setUniform("eye_pos", camera.getPosition());
+    switch (format)
+    {
+    case DEPTH_PNG16:
+        return "png";
+    case DEPTH_PGM16:
+        return "pgm";
+    case DEPTH_FLOAT_RAW:
+        return "raw";
+    case DEPTH_RAW:
+        return "praw";
+    case DEPTH_NPY:
+    default:
+        return "npy";
+    }
 }
 
-void Photographer::drawMainObject_(Shader& shader)
+void Photographer::initFaceIndexExport_(RenderTarget& target, bool attach)
 {
-    shader.use();
-    glBindVertexArray(this->object_vertex_array_);
+    if (attach == (target.face_idx_buffer != 0))
+    {
+        return;
+    }
 
-    glm::mat4 model = glm::mat4(1.0f);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    if (!attach)
+    {
+        // back to the color-only rendering
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, 0, 0);
+        glDrawBuffer(GL_COLOR_ATTACHMENT0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteTextures(1, &target.face_idx_buffer);
+        target.face_idx_buffer = 0;
+        return;
+    }
 
-    shader.setUniform("model", model);
-    shader.setUniform("normal_matrix", glm::transpose(glm::inverse(model)));
+    glGenTextures(1, &target.face_idx_buffer);
+    glBindTexture(GL_TEXTURE_2D, target.face_idx_buffer);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, target.width, target.height, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+    // integer textures can't be filtered
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // frag_face_idx of the fragment shaders goes here
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, target.face_idx_buffer, 0);
+    GLenum draw_buffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, draw_buffers);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cout << "ERROR::RenderToImage:: Framebuffer with the face index attachment is not complete!" << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
 
-    switch (vertex_shader_type_) {
-    case Shader::NOTEXTURE_SHADER:
-        glDrawElements(GL_TRIANGLES, object_->getFaces().size(), GL_UNSIGNED_INT, 0);
-        break;
-    case Shader::TEXTURE_SHADER:
-        glBindTexture(GL_TEXTURE_2D, object_texture_);
+int Photographer::saveFaceIndicesToFile_(const std::string filename, FaceIndexFormats format, const ImageView& face_idx)
+{
+    switch (format)
+    {
+    case FACE_IDX_NPY:
+        return ImageWriter::writeUIntNpy(filename, face_idx.width, face_idx.height, 
+            (const unsigned int*)face_idx.data, face_idx.stride);
+    case FACE_IDX_RAW:
+        return ImageWriter::writeRaw(filename, face_idx.width, face_idx.height, 1, ImageWriter::RAW_UINT32, 
+            face_idx.data, face_idx.stride);
+    case FACE_IDX_PFID:
     default:
-        glDrawArrays(GL_TRIANGLES, 0, (object_)->getFaces().size());
-        glBindTexture(GL_TEXTURE_2D, 0);
+        return ImageWriter::writeFaceIndexMap(filename, face_idx.width, face_idx.height, 
+            (const unsigned int*)face_idx.data, face_idx.stride);
     }
-
-    glBindVertexArray(0);
 }
 
-void Photographer::drawImageCameraObjects_(Shader & shader)
+const char* Photographer::faceIndexFileExtension_(FaceIndexFormats format)
 {
-    shader.use();
-    glBindVertexArray(this->cam_obj_vertex_array_);
-
-    for (auto &&camera : image_cameras_)
+    switch (format)
     {
-        glm::mat3 rotation = glm::transpose(glm::mat3(camera.getGlViewMatrix()));
-        glm::mat4 model = glm::mat4(rotation);
-        model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    case FACE_IDX_NPY:
+        return "npy";
+    case FACE_IDX_RAW:
+        return "praw";
+    case FACE_IDX_PFID:
+    default:
+        return "pfid";
+    }
+}
 
-        model[3] = glm::vec4(camera.getPosition(), 1.0f);
+void Photographer::initMultisampling_(RenderTarget& target)
+{
+    bool face_idx = target.face_idx_buffer != 0;
+    int n_samples = multisample_samples_;
+    if (n_samples > 1)
+    {
+        // all the attachments should have the same number of samples
+        GLint max_samples = 0;
+        GLint max_depth_samples = 0;
+        glGetIntegerv(GL_MAX_SAMPLES, &max_samples);
+        glGetIntegerv(GL_MAX_DEPTH_TEXTURE_SAMPLES, &max_depth_samples);
+        n_samples = std::min(n_samples, (int)std::min(max_samples, max_depth_samples));
+        if (face_idx)
+        {
+            GLint max_integer_samples = 0;
+            glGetIntegerv(GL_MAX_INTEGER_SAMPLES, &max_integer_samples);
+            n_samples = std::min(n_samples, (int)max_integer_samples);
+        }
+    }
 
-        shader.setUniform("model", model);
-        shader.setUniform("normal_matrix", glm::transpose(glm::inverse(model)));
-        glDrawElements(GL_TRIANGLES, camera_model_faces_num_ * 3, GL_UNSIGNED_INT, 0); 
+    if (target.multisample_framebuffer 
+        && target.multisample_samples == n_samples && target.multisample_face_idx == face_idx)
+    {
+        return;
+    }
+    deleteMultisampling_(target);
+    if (n_samples <= 1)
+    {
+        if (multisample_samples_ > 1)
+        {
+            std::cout << "WARNING::MULTISAMPLING::Not supported by the GPU. Rendering without it" << std::endl;
+        }
+        return;
+    }
+    if (n_samples < multisample_samples_)
+    {
+        std::cout << "WARNING::MULTISAMPLING::" << multisample_samples_ << " samples are not supported. Using " 
+            << n_samples << std::endl;
     }
 
-    glBindVertexArray(0);
-}
+    glGenFramebuffers(1, &target.multisample_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target.multisample_framebuffer);
 
-GLFWwindow* Photographer::initWindowContext_(bool visible)
-{
-    glfwInit();
+    // the resolving blit needs the same format as the color buffer of the target
+    glGenRenderbuffers(1, &target.multisample_color_buffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, target.multisample_color_buffer);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, n_samples, GL_RGB8, target.width, target.height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.multisample_color_buffer);
 
-    // Configure GLFW
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glGenTextures(1, &target.multisample_depth_buffer);
+    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, target.multisample_depth_buffer);
+    glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, n_samples, GL_DEPTH_COMPONENT32F, target.width, target.height, GL_TRUE);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D_MULTISAMPLE, target.multisample_depth_buffer, 0);
 
-    if (!visible)
+    if (face_idx)
     {
-        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        glGenTextures(1, &target.multisample_face_idx_buffer);
+        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, target.multisample_face_idx_buffer);
+        glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, n_samples, GL_R32UI, target.width, target.height, GL_TRUE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D_MULTISAMPLE, target.multisample_face_idx_buffer, 0);
+        GLenum draw_buffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, draw_buffers);
     }
+    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
 
-#ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // uncomment this statement to fix compilation on OS X
-#endif
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
 
-    // create a window
-    GLFWwindow* window = glfwCreateWindow(win_width_, win_height_, "Photographer", NULL, NULL);
-    if (window == NULL)
+    // depth & face index come from the sample closest to the pixel center -- as without multisampling
+    int center_sample = 0;
+    float min_distance = 1.0f;
+    for (int sample = 0; complete && sample < n_samples; ++sample)
     {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return 0;
+        GLfloat position[2] = { 0.5f, 0.5f };
+        glGetMultisamplefv(GL_SAMPLE_POSITION, sample, position);
+        float distance = std::abs(position[0] - 0.5f) + std::abs(position[1] - 0.5f);
+        if (distance < min_distance)
+        {
+            min_distance = distance;
+            center_sample = sample;
+        }
     }
-    glfwMakeContextCurrent(window);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-    // load glad
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    // the resolve pass is shared by all the targets
+    if (complete && multisample_resolve_shader_ == nullptr)
     {
-        std::cout << "Failed to initialize GLAD" << std::endl;
-        return 0;
+        multisample_resolve_shader_ = new Shader(Shader::MULTISAMPLE_RESOLVE_PASS);
+        if (multisample_resolve_shader_->isLinked())
+        {
+            multisample_resolve_shader_->use();
+            multisample_resolve_shader_->setUniform("depth_samples", 0);
+            multisample_resolve_shader_->setUniform("face_idx_samples", 1);
+            glGenVertexArrays(1, &multisample_vertex_array_);
+        }
+    }
+    if (!complete || !multisample_resolve_shader_->isLinked())
+    {
+        std::cout << "ERROR::MULTISAMPLING::Failed to set up the multisampled framebuffer. Rendering without it" << std::endl;
+        deleteMultisampling_(target);
+        return;
     }
 
-    // set viewport size -- viewport is needed to calc screen coordinates from normalized range
-    glViewport(0, 0, win_width_, win_height_);
+    target.multisample_samples = n_samples;
+    target.multisample_face_idx = face_idx;
+    target.multisample_center_sample = center_sample;
+}
 
-    glEnable(GL_CULL_FACE);
-    glEnable(GL_DEPTH_TEST);
+void Photographer::deleteMultisampling_(RenderTarget& target)
+{
+    if (target.multisample_framebuffer)
+    {
+        glDeleteFramebuffers(1, &target.multisample_framebuffer);
+        target.multisample_framebuffer = 0;
+    }
+    if (target.multisample_color_buffer)
+    {
+        glDeleteRenderbuffers(1, &target.multisample_color_buffer);
+        target.multisample_color_buffer = 0;
+    }
+    if (target.multisample_depth_buffer)
+    {
+        glDeleteTextures(1, &target.multisample_depth_buffer);
+        target.multisample_depth_buffer = 0;
+    }
+    if (target.multisample_face_idx_buffer)
+    {
+        glDeleteTextures(1, &target.multisample_face_idx_buffer);
+        target.multisample_face_idx_buffer = 0;
+    }
+    target.multisample_samples = 0;
+    target.multisample_face_idx = false;
+}
 
-    // TUTORIAL for a mouse control
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+void Photographer::resolveMultisampling_(const RenderTarget& target)
+{
+    // the blit writes into every draw buffer, but the integer face indices can't take the averaged color
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, target.multisample_framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target.framebuffer);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glDrawBuffer(GL_COLOR_ATTACHMENT0);
+    glBlitFramebuffer(0, 0, target.width, target.height, 0, 0, target.width, target.height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+    if (target.face_idx_buffer)
+    {
+        GLenum draw_buffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, draw_buffers);
+    }
+    if (!depth_export_ && !target.face_idx_buffer)
+    {
+        return;
+    }
 
-    return window;
+    // depth & face index of a single sample through a full-screen pass: values are copied, not blended
+    glColorMaski(0, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthFunc(GL_ALWAYS);
+
+    multisample_resolve_shader_->use();
+    multisample_resolve_shader_->setUniform("sample_index", target.multisample_center_sample);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, target.multisample_depth_buffer);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, target.multisample_face_idx_buffer);
+    glBindVertexArray(multisample_vertex_array_);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+
+    glDepthFunc(GL_LESS);
+    glColorMaski(0, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 }
 
-void Photographer::initCustomBuffer_()
+std::vector<FaceVisibility> Photographer::computeFaceVisibilityGL_()
 {
-    // create framebuffer
-    if (!framebuffer_)
+    std::vector<FaceVisibility> visibility;
+    if (fragment_shader_type_ == Shader::DEFAULT_SHADER)
     {
-        glGenFramebuffers(1, &framebuffer_);
-        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
-    }   
-    else // or just reuse previous framebuffer
+        std::cout << "ERROR::FACE VISIBILITY::DEFAULT fragment shader doesn't output face indices. Nothing is computed" << std::endl;
+        return visibility;
+    }
+
+    bool own_context = !session_open_;
+    if ((own_context && !initRenderContext_()) || (!own_context && !updateScene_()))
     {
-        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+        std::cout << "ERROR::FACE VISIBILITY::Failed to set up the context. Nothing is computed" << std::endl;
+        return visibility;
     }
 
-    if (!texture_color_buffer_)
+    // bitsets of the cameras are stacked in one texture and read back a batch at a time
+    std::size_t n_faces = object_->getGLMFaces().size() / 3;
+    int n_words = (int)((n_faces + 31) / 32);
+    GLint max_size = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+    int width = std::max(1, std::min(n_words, std::min((int)visibility_max_width_, (int)max_size)));
+    int rows_per_camera = std::max(1, (n_words + width - 1) / width);
+    std::size_t cameras_per_batch = std::min(image_cameras_.size(), (std::size_t)std::max(1, (int)max_size / rows_per_camera));
+
+    if (rows_per_camera > max_size || !initFaceVisibility_(width, rows_per_camera, cameras_per_batch))
     {
-        glGenTextures(1, &texture_color_buffer_);
-        glBindTexture(GL_TEXTURE_2D, texture_color_buffer_);
-        // dimention should match current Viewport dimentions (call glViewport if the change is needed)
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, win_width_, win_height_, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glBindTexture(GL_TEXTURE_2D, 0);
+        std::cout << "ERROR::FACE VISIBILITY::Failed to set up the visibility buffers. Nothing is computed" << std::endl;
+        if (own_context)
+        {
+            cleanAndCloseContext_();
+        }
+        return visibility;
+    }
+    // face indices are rendered, but not read back
+    std::vector<ImageSize> image_sizes = imageSizes_();
+    for (auto &&size : image_sizes)
+    {
+        initRenderTarget_(size, true);
+    }
 
-        // attach to framebuffer
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture_color_buffer_, 0);
-    } // or reuse
-    
-    if (!depth_render_buffer_)
+    std::vector<GLuint> bits((std::size_t)width * rows_per_camera * cameras_per_batch);
+    // set per camera
+    const Shader::Uniform image_width_uniform = visibility_shader_->getUniform("image_width");
+    const Shader::Uniform first_row_uniform = visibility_shader_->getUniform("first_row");
+    GLuint no_bits[4] = { 0, 0, 0, 0 };
+    GLuint background[4] = { Frame::background_face_idx, 0, 0, 0 };
+    visibility.reserve(image_cameras_.size());
+    for (std::size_t first = 0; first < image_cameras_.size(); first += cameras_per_batch)
     {
-        glGenRenderbuffers(1, &depth_render_buffer_);
-        glBindRenderbuffer(GL_RENDERBUFFER, depth_render_buffer_);
-        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, win_width_, win_height_);
+        std::size_t n_cameras = std::min(cameras_per_batch, image_cameras_.size() - first);
 
-        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth_render_buffer_);
-        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, visibility_framebuffer_);
+        glClearBufferuiv(GL_COLOR, 0, no_bits);
+
+        for (std::size_t i = 0; i < n_cameras; ++i)
+        {
+            // face indices only: the color is not written
+            const Camera& camera = image_cameras_[first + i];
+            const RenderTarget& target = renderTarget_(camera, true, false);
+            glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+            glViewport(0, 0, target.width, target.height);
+            glColorMaski(0, GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            glClearBufferuiv(GL_COLOR, 1, background);
+            cameraParamsToUniforms_(camera);
+            drawMainObject_(*shader_);
+            glColorMaski(0, GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+            // a point per pixel sets the bit of its face in the rows of the camera
+            glBindFramebuffer(GL_FRAMEBUFFER, visibility_framebuffer_);
+            glViewport(0, 0, visibility_buffer_width_, visibility_buffer_height_);
+            glEnable(GL_COLOR_LOGIC_OP);
+            glLogicOp(GL_OR);
+
+            visibility_shader_->use();
+            visibility_shader_->setUniform(image_width_uniform, target.width);
+            visibility_shader_->setUniform(first_row_uniform, (int)i * rows_per_camera);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, target.face_idx_buffer);
+            glBindVertexArray(visibility_vertex_array_);
+            glDrawArrays(GL_POINTS, 0, target.width * target.height);
+            glBindVertexArray(0);
+            glBindTexture(GL_TEXTURE_2D, 0);
+
+            glDisable(GL_COLOR_LOGIC_OP);
+        }
+
+        // the only transfer of the batch
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(0, 0, width, rows_per_camera * (int)n_cameras, GL_RED_INTEGER, GL_UNSIGNED_INT, &bits[0]);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        for (std::size_t i = 0; i < n_cameras; ++i)
+        {
+            FaceVisibility camera_visibility;
+            camera_visibility.camera_id = image_cameras_[first + i].getID();
+            camera_visibility.n_faces = n_faces;
+            auto camera_bits = bits.begin() + i * width * rows_per_camera;
+            camera_visibility.words.assign(camera_bits, camera_bits + n_words);
+            visibility.push_back(std::move(camera_visibility));
+        }
     }
 
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    if (!face_idx_export_)
+    {
+        for (auto &&size : image_sizes)
+        {
+            initFaceIndexExport_(render_targets_[size], false);
+        }
+    }
+    if (own_context)
     {
-        std::cout << "ERROR::RenderToImage:: Framebuffer is not complete!" << std::endl;
+        cleanAndCloseContext_();
     }
+
+    return visibility;
 }
 
-void Photographer::cleanAndCloseContext_()
+std::vector<FaceVisibility> Photographer::computeFaceVisibilitySoftware_()
 {
-    // object-related. Should always be there
-    glDeleteVertexArrays(1, &object_vertex_array_);
-    glDeleteBuffers(1, &object_vertex_buffer_);
-    glDeleteBuffers(1, &object_element_buffer_);
-    object_vertex_array_ = object_element_buffer_ = object_vertex_buffer_ = 0;
+    std::vector<FaceVisibility> visibility;
+    if (!SoftwareRasterizer::isSupported(vertex_shader_type_) || vertex_shader_type_ != fragment_shader_type_)
+    {
+        std::cout << "ERROR::FACE VISIBILITY::Software renderer supports NOTEXTURE, TEXTURE, FACEIDX and FLAT shaders "
+            << "(same for vertex and fragment). Nothing is computed" << std::endl;
+        return visibility;
+    }
 
-    // camera
-    glDeleteVertexArrays(1, &cam_obj_vertex_array_);
-    glDeleteBuffers(1, &cam_obj_vertex_buffer_);
-    glDeleteBuffers(1, &cam_obj_element_buffer_);
-    cam_obj_vertex_array_ = cam_obj_vertex_buffer_ = cam_obj_element_buffer_ = 0;
+    SoftwareRasterizer rasterizer(image_cameras_[0].getWidth(), image_cameras_[0].getHeight(), 
+        std::max(1u, std::thread::hardware_concurrency()));
+    rasterizer.setShaderType(vertex_shader_type_);
+    rasterizer.setShadingParams(shading_params_);
+    loadSoftwareGeometry_(rasterizer);
+
+    std::size_t n_faces = object_->getGLMFaces().size() / 3;
+    std::vector<unsigned char> image;
+    std::vector<unsigned int> face_idx;
+    visibility.reserve(image_cameras_.size());
+    for (auto &&camera : image_cameras_)
+    {
+        rasterizer.setImageSize(camera.getWidth(), camera.getHeight());
+        image.resize((std::size_t)camera.getWidth() * camera.getHeight() * 3);
+        face_idx.resize((std::size_t)camera.getWidth() * camera.getHeight());
+        rasterizer.render(camera.getGlViewMatrix(), camera.getGlProjectionMatrix(), camera.getPosition(), 
+            &image[0], &face_idx[0]);
+
+        FaceVisibility camera_visibility;
+        camera_visibility.camera_id = camera.getID();
+        camera_visibility.n_faces = n_faces;
+        camera_visibility.words.assign((n_faces + 31) / 32, 0);
+        for (unsigned int face : face_idx)
+        {
+            if (face < n_faces)     // skips the background
+            {
+                camera_visibility.words[face / 32] |= 1u << (face % 32);
+            }
+        }
+        visibility.push_back(std::move(camera_visibility));
+    }
+
+    return visibility;
+}
 
-    if (framebuffer_)
+bool Photographer::initFaceVisibility_(int width, int rows_per_camera, std::size_t cameras_per_batch)
+{
+    if (visibility_shader_ == nullptr)
     {
-        glDeleteFramebuffers(1, &framebuffer_);
-        framebuffer_ = 0;
+        visibility_shader_ = new Shader(Shader::FACE_VISIBILITY_PASS);
+        if (!visibility_shader_->isLinked())
+        {
+            std::cout << "ERROR::FACE VISIBILITY::Failed to build the visibility shader" << std::endl;
+            deleteFaceVisibility_();
+            return false;
+        }
+        visibility_shader_->use();
+        visibility_shader_->setUniform("face_idx", 0);
     }
-    if (texture_color_buffer_)
+    if (!visibility_vertex_array_)
     {
-        glDeleteTextures(1, &texture_color_buffer_);
-        texture_color_buffer_ = 0;
+        glGenVertexArrays(1, &visibility_vertex_array_);
     }
 
-    if (depth_render_buffer_)
+    int height = rows_per_camera * (int)cameras_per_batch;
+    if (visibility_buffer_ && visibility_buffer_width_ == width && visibility_buffer_height_ == height)
     {
-        glDeleteRenderbuffers(1, &depth_render_buffer_);
-        depth_render_buffer_ = 0;
+        return true;
     }
 
-    if (shader_ != nullptr)
+    if (!visibility_buffer_)
     {
-        delete shader_;
-        shader_ = nullptr;
+        glGenTextures(1, &visibility_buffer_);
     }
+    glBindTexture(GL_TEXTURE_2D, visibility_buffer_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, width, height, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
 
-    if (simple_shader_ != nullptr)
+    if (!visibility_framebuffer_)
     {
-        delete simple_shader_;
-        simple_shader_ = nullptr;
+        glGenFramebuffers(1, &visibility_framebuffer_);
     }
-    
-    if (view_camera_ != nullptr)
+    glBindFramebuffer(GL_FRAMEBUFFER, visibility_framebuffer_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, visibility_buffer_, 0);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete)
     {
-        delete view_camera_;
-        view_camera_ = nullptr;
+        std::cout << "ERROR::FACE VISIBILITY::Visibility framebuffer is not complete!" << std::endl;
+        deleteFaceVisibility_();
+        return false;
     }
 
-    glfwTerminate();
+    visibility_buffer_width_ = width;
+    visibility_buffer_height_ = height;
+    visibility_shader_->use();
+    visibility_shader_->setUniform("target_width", width);
+    visibility_shader_->setUniform("target_height", height);
+
+    return true;
 }
 
-int Photographer::saveRGBTexToFile_(const std::string filename, unsigned int texture_id)
+void Photographer::deleteFaceVisibility_()
 {
-    glBindTexture(GL_TEXTURE_2D, texture_id);
-    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    if (visibility_shader_ != nullptr)
+    {
+        delete visibility_shader_;
+        visibility_shader_ = nullptr;
+    }
+    if (visibility_framebuffer_)
+    {
+        glDeleteFramebuffers(1, &visibility_framebuffer_);
+        visibility_framebuffer_ = 0;
+    }
+    if (visibility_buffer_)
+    {
+        glDeleteTextures(1, &visibility_buffer_);
+        visibility_buffer_ = 0;
+    }
+    if (visibility_vertex_array_)
+    {
+        glDeleteVertexArrays(1, &visibility_vertex_array_);
+        visibility_vertex_array_ = 0;
+    }
+    visibility_buffer_width_ = visibility_buffer_height_ = 0;
+}
 
-    int width, height, n_channels, internal_format;
-    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
-    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
-    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internal_format);
+ImageView Photographer::scalarImageView_(const unsigned char* data, int width, int height, unsigned int camera_id)
+{
+    ImageView view;
+    view.data = data;
+    view.width = width;
+    view.height = height;
+    view.channels = 1;
+    view.bytes_per_channel = 4;
+    view.stride = width * 4;
+    view.camera_id = camera_id;
+    return view;
+}
 
-    if (internal_format == GL_RGB) n_channels = 3;
-    else if (internal_format == GL_RGBA) n_channels = 4;
-    else
+ImageEncoderPool::PixelBuffer Photographer::copyReadbackBuffer_(unsigned int buffer, std::size_t size, ImageEncoderPool& encoder)
+{
+    ImageEncoderPool::PixelBuffer copy;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+    void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if (data != nullptr)
     {
-        n_channels = 3;
-        std::cout << "Photographer::WARNING::WRITING TEXTURE TO FILE::Unknown texture format " << internal_format
-            << ". The default number of channels (3) is used." << std::endl;
+        copy = encoder.acquireBuffer(size);
+        std::memcpy(copy->data(), data, size);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
     }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
 
-    std::vector<unsigned char> image(width *  height * n_channels);
-    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGB, GL_UNSIGNED_BYTE, image.data());
+    return copy;
+}
+
+int Photographer::saveImageToFile_(const std::string filename, ImageFormats format, int png_compression_level, const ImageView& image)
+{
+    switch (format)
+    {
+    case IMAGE_PPM:
+        return ImageWriter::writePNM(filename, image.width, image.height, image.channels, image.data, image.stride);
+    case IMAGE_QOI:
+        return ImageWriter::writeQOI(filename, image.width, image.height, image.channels, image.data, image.stride);
+    case IMAGE_RAW:
+        return ImageWriter::writeRaw(filename, image.width, image.height, image.channels, ImageWriter::RAW_UINT8, 
+            image.data, image.stride);
+    case IMAGE_NPY:
+        return ImageWriter::writeUByteNpy(filename, image.width, image.height, image.channels, image.data, image.stride);
+    case IMAGE_PNG:
+    default:
+        return ImageWriter::writePNG(filename, image.width, image.height, image.channels, image.data, image.stride, 
+            png_compression_level);
+    }
+}
 
-    stbi_flip_vertically_on_write(true);    // Gl texture coord system is upside down
-    int success = stbi_write_png(filename.c_str(), width, height, n_channels, image.data(), 0);
+const char* Photographer::imageFileExtension_(ImageFormats format)
+{
+    switch (format)
+    {
+    case IMAGE_PPM:
+        return "ppm";
+    case IMAGE_QOI:
+        return "qoi";
+    case IMAGE_RAW:
+        return "praw";
+    case IMAGE_NPY:
+        return "npy";
+    case IMAGE_PNG:
+    default:
+        return "png";
+    }
+}
 
-    if (!success)
+int Photographer::saveMaskToFile_(const std::string filename, const ImageView& face_idx)
+{
+    std::vector<unsigned char> mask((std::size_t)face_idx.width * face_idx.height);
+    for (int y = 0; y < face_idx.height; ++y)
     {
-        // don't know how to get the failure reason info
-        std::cout << "ERROR::WRITING TEXTURE TO FILE::Failed to save png." 
-            << "Check that the specified path exists:" << std::endl
-            << filename << std::endl;
+        const unsigned int* row = (const unsigned int*)face_idx.row(y);
+        for (int x = 0; x < face_idx.width; ++x)
+        {
+            mask[(std::size_t)y * face_idx.width + x] = row[x] == Frame::background_face_idx ? 0 : 255;
+        }
     }
+    return ImageWriter::writePNG(filename, face_idx.width, face_idx.height, 1, mask.data(), face_idx.width);
+}
 
-    glBindTexture(GL_TEXTURE_2D, texture_id);
+DatasetWriter::View Photographer::datasetView_(const Camera& camera)
+{
+    DatasetWriter::View view;
+    view.params = CameraParamsWriter::record(camera);
 
-    return success;
+    // camera-to-world of the GL camera, row-major from the colwise storage
+    const glm::mat4& transform = camera.getGlCameraToWorldMatrix();
+    for (int i = 0; i < 4; ++i)
+    {
+        for (int j = 0; j < 4; ++j)
+        {
+            view.transform[i * 4 + j] = transform[j][i];
+        }
+    }
+    return view;
 }
 
 void Photographer::registerCallbacks_(GLFWwindow * window)
 {
+    // callbacks find the instance through the window
+    glfwSetWindowUserPointer(window, this);
     glfwSetFramebufferSizeCallback(window, Photographer::framebufferSizeCallback_);
     glfwSetCursorPosCallback(window, Photographer::mouseCallback);
     glfwSetScrollCallback(window, Photographer::scrollCallback);
@@ -745,22 +3063,33 @@ void Photographer::framebufferSizeCallback_(GLFWwindow * window, int width, int
 
 void Photographer::mouseCallback(GLFWwindow * window, double xpos, double ypos)
 {
-    if (first_mouse_)
+    Photographer* photographer = (Photographer*)glfwGetWindowUserPointer(window);
+    if (photographer == nullptr || photographer->view_camera_ == nullptr)
+    {
+        return;
+    }
+
+    if (photographer->first_mouse_)
     {
-        lastX_ = xpos;
-        lastY_ = ypos;
-        first_mouse_ = false;
+        photographer->lastX_ = xpos;
+        photographer->lastY_ = ypos;
+        photographer->first_mouse_ = false;
     }
 
-    float xoffset = xpos - lastX_;
-    float yoffset = lastY_ - ypos; // reversed since y-coordinates range from bottom to top
-    lastX_ = xpos;
-    lastY_ = ypos;
+    float xoffset = xpos - photographer->lastX_;
+    float yoffset = photographer->lastY_ - ypos; // reversed since y-coordinates range from bottom to top
+    photographer->lastX_ = xpos;
+    photographer->lastY_ = ypos;
 
-    view_camera_->updateRotation(yoffset, xoffset);
+    photographer->view_camera_->updateRotation(yoffset, xoffset);
 }
 
 void Photographer::scrollCallback(GLFWwindow * window, double xoffset, double yoffset)
 {
-    view_camera_->zoom(yoffset);
+    Photographer* photographer = (Photographer*)glfwGetWindowUserPointer(window);
+    if (photographer == nullptr || photographer->view_camera_ == nullptr)
+    {
+        return;
+    }
+    photographer->view_camera_->zoom(yoffset);
 }
@@ -0,0 +1,103 @@
+#include "../header/RenderSession.h"
+
+RenderSession::RenderSession(Photographer& photographer) : photographer_(photographer)
+{
+    if (photographer_.session_open_)
+    {
+        // the session is shared and is closed by its owner
+        std::cout << "WARNING::RENDER SESSION::Photographer already has an open session" << std::endl;
+        return;
+    }
+
+    owner_ = photographer_.openSession_();
+    if (!owner_)
+    {
+        std::cout << "ERROR::RENDER SESSION::Failed to create the context" << std::endl;
+    }
+}
+
+RenderSession::~RenderSession()
+{
+    close();
+}
+
+bool RenderSession::isOpen() const
+{
+    return photographer_.session_open_;
+}
+
+void RenderSession::close()
+{
+    if (owner_)
+    {
+        photographer_.closeSession_();
+        // might fail on a wrong thread, the destructor tries again
+        owner_ = photographer_.session_open_;
+    }
+}
+
+std::vector<std::string> RenderSession::renderToImages(const std::string path, const std::string prefix)
+{
+    if (!isOpen())
+    {
+        std::cout << "ERROR::RENDER SESSION::Session is closed. Nothing is rendered" << std::endl;
+        return std::vector<std::string>();
+    }
+
+    return photographer_.renderToImages(path, prefix);
+}
+
+std::vector<Frame> RenderSession::renderToFrames()
+{
+    if (!isOpen())
+    {
+        std::cout << "ERROR::RENDER SESSION::Session is closed. Nothing is rendered" << std::endl;
+        return std::vector<Frame>();
+    }
+
+    return photographer_.renderToFrames();
+}
+
+void RenderSession::renderToCallback(Photographer::FrameCallback on_frame)
+{
+    if (!isOpen())
+    {
+        std::cout << "ERROR::RENDER SESSION::Session is closed. Nothing is rendered" << std::endl;
+        return;
+    }
+
+    photographer_.renderToCallback(on_frame);
+}
+
+int RenderSession::renderToArchive(const std::string filename)
+{
+    if (!isOpen())
+    {
+        std::cout << "ERROR::RENDER SESSION::Session is closed. Nothing is rendered" << std::endl;
+        return 0;
+    }
+
+    return photographer_.renderToArchive(filename);
+}
+
+int RenderSession::renderToDataset(const std::string path, DatasetWriter::Formats formats, bool with_masks)
+{
+    if (!isOpen())
+    {
+        std::cout << "ERROR::RENDER SESSION::Session is closed. Nothing is rendered" << std::endl;
+        return 0;
+    }
+
+    return photographer_.renderToDataset(path, formats, with_masks);
+}
+
+std::vector<FaceVisibility> RenderSession::computeFaceVisibility()
+{
+    if (!isOpen())
+    {
+        std::cout << "ERROR::RENDER SESSION::Session is closed. Nothing is computed" << std::endl;
+        return std::vector<FaceVisibility>();
+    }
+
+    return photographer_.computeFaceVisibility();
+}
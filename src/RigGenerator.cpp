@@ -0,0 +1,109 @@
+#include "../header/RigGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include <glm/gtc/constants.hpp>
+
+void RigGenerator::fibonacciSphere(std::vector<glm::vec3>& positions, int n, float radius, glm::vec3 center)
+{
+    if (n <= 0)
+    {
+        return;
+    }
+    positions.reserve(positions.size() + n);
+
+    const float golden_angle = glm::pi<float>() * (3.0f - std::sqrt(5.0f));
+    for (int i = 0; i < n; ++i)
+    {
+        // heights at the centers of n equal-area bands
+        float y = 1.0f - 2.0f * (i + 0.5f) / n;
+        float ring_radius = std::sqrt(std::max(0.0f, 1.0f - y * y));
+        float phi = golden_angle * i;
+        positions.push_back(center + radius * glm::vec3(std::cos(phi) * ring_radius, y, std::sin(phi) * ring_radius));
+    }
+}
+
+void RigGenerator::latLongGrid(std::vector<glm::vec3>& positions, int n_latitudes, int n_longitudes,
+    float min_latitude, float max_latitude, float radius, glm::vec3 center)
+{
+    if (n_latitudes <= 0 || n_longitudes <= 0)
+    {
+        return;
+    }
+    positions.reserve(positions.size() + (std::size_t)n_latitudes * n_longitudes);
+
+    for (int lat = 0; lat < n_latitudes; ++lat)
+    {
+        float latitude = n_latitudes > 1
+            ? min_latitude + (max_latitude - min_latitude) * lat / (n_latitudes - 1)
+            : 0.5f * (min_latitude + max_latitude);
+        float theta = glm::radians(latitude);
+        for (int lon = 0; lon < n_longitudes; ++lon)
+        {
+            float phi = glm::two_pi<float>() * lon / n_longitudes;
+            positions.push_back(center + radius * glm::vec3(
+                std::cos(theta) * std::cos(phi), std::sin(theta), std::cos(theta) * std::sin(phi)));
+        }
+    }
+}
+
+void RigGenerator::jitteredShells(std::vector<glm::vec3>& positions, int n_per_shell, const std::vector<float>& radii,
+    float jitter, unsigned int seed, glm::vec3 center)
+{
+    if (n_per_shell <= 0)
+    {
+        return;
+    }
+    positions.reserve(positions.size() + (std::size_t)n_per_shell * radii.size());
+
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> shift(-jitter, jitter);
+    for (auto &&radius : radii)
+    {
+        std::size_t first = positions.size();
+        fibonacciSphere(positions, n_per_shell);
+        for (std::size_t i = first; i < positions.size(); ++i)
+        {
+            glm::vec3 direction = glm::normalize(positions[i] + glm::vec3(shift(generator), shift(generator), shift(generator)));
+            positions[i] = center + radius * direction;
+        }
+    }
+}
+
+void RigGenerator::ring(std::vector<glm::vec3>& positions, int n, float y, float radius)
+{
+    if (n <= 0)
+    {
+        return;
+    }
+    positions.reserve(positions.size() + n);
+
+    for (int i = 0; i < n; ++i)
+    {
+        float theta = glm::two_pi<float>() * i / n;
+        positions.push_back(glm::vec3(radius * std::cos(theta), y, radius * std::sin(theta)));
+    }
+}
+
+void RigGenerator::shakerGrid(std::vector<glm::vec3>& positions, glm::vec3 center, glm::ivec3 half_steps, glm::vec3 step)
+{
+    if (half_steps.x < 0 || half_steps.y < 0 || half_steps.z < 0)
+    {
+        return;
+    }
+    positions.reserve(positions.size()
+        + (std::size_t)(2 * half_steps.x + 1) * (2 * half_steps.y + 1) * (2 * half_steps.z + 1));
+
+    for (int k = -half_steps.z; k <= half_steps.z; ++k)
+    {
+        for (int j = -half_steps.y; j <= half_steps.y; ++j)
+        {
+            for (int i = -half_steps.x; i <= half_steps.x; ++i)
+            {
+                positions.push_back(center + glm::vec3(i, j, k) * step);
+            }
+        }
+    }
+}
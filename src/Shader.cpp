@@ -1,89 +1,174 @@
 #include "../header/Shader.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
 
-Shader::Shader(ShaderTypes vertex_shader_type, ShaderTypes fragment_shader_type)
+#include <GeneralUtility.h>
+
+namespace
+{
+    // the cache is shared by all the Photographers of the process
+    std::mutex binary_cache_mutex;
+    bool binary_cache_dir_set = false;
+    std::string binary_cache_dir;
+
+    const char binary_cache_magic[4] = { 'P', 'H', 'S', 'B' };
+    std::once_flag binary_cache_write_warning;
+
+    std::string defaultBinaryCacheDir()
+    {
+        const char* value = std::getenv("PHOTOGRAPHER_SHADER_CACHE");
+        if (value != nullptr)
+        {
+            return value;
+        }
+        for (const char* name : { "TMPDIR", "TEMP", "TMP" })
+        {
+            value = std::getenv(name);
+            if (value != nullptr && value[0] != '\0')
+            {
+                return std::string(value) + "/photographer_shader_cache";
+            }
+        }
+        return "/tmp/photographer_shader_cache";
+    }
+
+    // mg::mkDir() creates a single level
+    void makeDirs(const std::string& path)
+    {
+        for (std::size_t pos = path.find_first_of("/\\", 1); pos != std::string::npos; pos = path.find_first_of("/\\", pos + 1))
+        {
+            mg::mkDir(path.substr(0, pos));
+        }
+        mg::mkDir(path);
+    }
+
+    bool isSupportedBinaryFormat(GLenum format)
+    {
+        int n_formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &n_formats);
+        std::vector<GLint> formats(n_formats > 0 ? n_formats : 0);
+        if (n_formats > 0)
+        {
+            glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data());
+        }
+        return std::find(formats.begin(), formats.end(), (GLint)format) != formats.end();
+    }
+
+    // FNV-1a
+    void hashString(std::uint64_t& hash, const char* str)
+    {
+        for (const char* c = str != nullptr ? str : ""; ; ++c)
+        {
+            hash ^= (unsigned char)*c;
+            hash *= 1099511628211ull;
+            if (*c == '\0')
+            {
+                break;  // the terminator separates the strings
+            }
+        }
+    }
+}
+
+Shader::Shader(ShaderTypes vertex_shader_type, ShaderTypes fragment_shader_type, bool layered)
 {
-    unsigned int vertex_shader;
-    unsigned int fragment_shader;
+    const char* vertex_code = nullptr;
+    const char* fragment_code = nullptr;
 
-    // Compile requested shaders
+    // Pick requested shaders
     switch (vertex_shader_type)
     {
     case ShaderTypes::NOTEXTURE_SHADER:
-        vertex_shader = Shader::compileVertexShader_(no_texture_vertex_shader_source);
+        vertex_code = layered ? no_texture_layered_vertex_shader_source : no_texture_vertex_shader_source;
         break;
     case ShaderTypes::TEXTURE_SHADER:
-        vertex_shader = Shader::compileVertexShader_(texture_vertex_shader_source);
+        vertex_code = layered ? texture_layered_vertex_shader_source : texture_vertex_shader_source;
         break;
     case ShaderTypes::FACEIDX_SHADER:
-        vertex_shader = Shader::compileVertexShader_(face_idx_vertex_shader_source);
+        vertex_code = layered ? face_idx_layered_vertex_shader_source : face_idx_vertex_shader_source;
         break;
     case ShaderTypes::FLAT_SHADER:
-        vertex_shader = Shader::compileVertexShader_(flat_vertex_shader_source);
+        vertex_code = layered ? flat_layered_vertex_shader_source : flat_vertex_shader_source;
         break;
     case ShaderTypes::DEFAULT_SHADER:
-        vertex_shader = Shader::compileVertexShader_(default_vertex_shader_source_);
+        vertex_code = default_vertex_shader_source_;
         break;
     }
 
     switch (fragment_shader_type)
     {
     case ShaderTypes::NOTEXTURE_SHADER:
-        fragment_shader = Shader::compileFragmentShader_(no_texture_fragment_shader_source);
+        fragment_code = no_texture_fragment_shader_source;
         break;
     case ShaderTypes::TEXTURE_SHADER:
-        fragment_shader = Shader::compileFragmentShader_(texture_fragment_shader_source);
+        fragment_code = texture_fragment_shader_source;
         break;
     case ShaderTypes::FACEIDX_SHADER:
-        fragment_shader = Shader::compileFragmentShader_(face_idx_fragment_shader_source);
+        fragment_code = face_idx_fragment_shader_source;
         break;
     case ShaderTypes::FLAT_SHADER:
-        fragment_shader = Shader::compileFragmentShader_(flat_fragment_shader_source);
+        fragment_code = flat_fragment_shader_source;
         break;
     case ShaderTypes::DEFAULT_SHADER:
-        fragment_shader = Shader::compileFragmentShader_(default_fragment_shader_source_);
+        fragment_code = default_fragment_shader_source_;
         break;
     }
 
-    // create program
-    createProgram_(vertex_shader, fragment_shader);
-
-    // cleanup
-    glDeleteShader(vertex_shader);
-    glDeleteShader(fragment_shader);
+    buildProgram_(vertex_code, fragment_code);
 }
 
-Shader::Shader(const GLchar * vertex_path, const GLchar * fragment_path)
+Shader::Shader(PassShaderTypes pass_type)
 {
-    unsigned int vertex_shader;
-    unsigned int fragment_shader;
-    // read & compile
-    if (vertex_path != nullptr)
-    {
-        std::string vertex_code = Shader::readCodeFile_(vertex_path);
-        vertex_shader = Shader::compileVertexShader_(vertex_code.c_str());
-    }
-    else
-    {
-        vertex_shader = Shader::compileVertexShader_(default_vertex_shader_source_);
-    }
-    
-    if (fragment_path != nullptr)
+    const char* vertex_code = nullptr;
+    const char* fragment_code = nullptr;
+
+    switch (pass_type)
     {
-        std::string fragment_code = Shader::readCodeFile_(fragment_path);
-        fragment_shader = Shader::compileFragmentShader_(fragment_code.c_str());
+    case PassShaderTypes::FACE_VISIBILITY_PASS:
+        vertex_code = face_visibility_vertex_shader_source;
+        fragment_code = face_visibility_fragment_shader_source;
+        break;
+    case PassShaderTypes::MULTISAMPLE_RESOLVE_PASS:
+        vertex_code = multisample_resolve_vertex_shader_source;
+        fragment_code = multisample_resolve_fragment_shader_source;
+        break;
     }
-    else
+
+    buildProgram_(vertex_code, fragment_code);
+}
+
+Shader::Shader(const GLchar * vertex_path, const GLchar * fragment_path)
+{
+    // read
+    std::string vertex_code = vertex_path != nullptr ? Shader::readCodeFile_(vertex_path) : default_vertex_shader_source_;
+    std::string fragment_code = fragment_path != nullptr ? Shader::readCodeFile_(fragment_path) : default_fragment_shader_source_;
+
+    buildProgram_(vertex_code.c_str(), fragment_code.c_str());
+}
+
+void Shader::setBinaryCacheDir(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(binary_cache_mutex);
+    binary_cache_dir = path;
+    binary_cache_dir_set = true;
+}
+
+std::string Shader::getBinaryCacheDir()
+{
+    std::lock_guard<std::mutex> lock(binary_cache_mutex);
+    if (!binary_cache_dir_set)
     {
-        fragment_shader = Shader::compileFragmentShader_(default_fragment_shader_source_);
+        binary_cache_dir = defaultBinaryCacheDir();
+        binary_cache_dir_set = true;
     }
-    
-    // create program
-    createProgram_(vertex_shader, fragment_shader);
-
-    // cleanup
-    glDeleteShader(vertex_shader);
-    glDeleteShader(fragment_shader);
+    return binary_cache_dir;
 }
 
 Shader::~Shader()
@@ -96,40 +181,81 @@ void Shader::use()
     glUseProgram(ID_);
 }
 
-void Shader::setUniform(const std::string & name, int value) const
+Shader::Uniform Shader::getUniform(const std::string & name) const
 {
-    int location = glGetUniformLocation(ID_, name.c_str());
-    glUniform1i(location, value);
+    Uniform uniform;
+    auto found = uniform_locations_.find(name);
+    if (found != uniform_locations_.end())
+    {
+        uniform.location = found->second;
+    }
+    return uniform;
+}
+
+void Shader::setUniform(Uniform uniform, int value) const
+{
+    glUniform1i(uniform.location, value);
 }
 
-void Shader::setUniform(const std::string & name, float value) const
+void Shader::setUniform(Uniform uniform, float value) const
 {
-    int location = glGetUniformLocation(ID_, name.c_str());
-    glUniform1f(location, value);
+    glUniform1f(uniform.location, value);
 }
 
-void Shader::setUniform(const std::string & name, glm::mat4 value) const
+void Shader::setUniform(Uniform uniform, const glm::mat4& value) const
 {
-    int location = glGetUniformLocation(ID_, name.c_str());
-    glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+    glUniformMatrix4fv(uniform.location, 1, GL_FALSE, glm::value_ptr(value));
 }
 
-void Shader::setUniform(const std::string & name, glm::vec3 value) const
+void Shader::setUniform(Uniform uniform, const glm::vec3& value) const
 {
-    int location = glGetUniformLocation(ID_, name.c_str());
-    glUniform3fv(location, 1, glm::value_ptr(value));
+    glUniform3fv(uniform.location, 1, glm::value_ptr(value));
 }
 
-void Shader::setUniform(const std::string & name, glm::vec4 value) const
+void Shader::setUniform(Uniform uniform, const glm::vec4& value) const
 {
-    int location = glGetUniformLocation(ID_, name.c_str());
-    glUniform4fv(location, 1, glm::value_ptr(value));
+    glUniform4fv(uniform.location, 1, glm::value_ptr(value));
+}
+
+bool Shader::isLinked() const
+{
+    int success;
+    glGetProgramiv(ID_, GL_LINK_STATUS, &success);
+    return success != 0;
+}
+
+void Shader::buildProgram_(const char* vertex_code, const char* fragment_code)
+{
+    std::string cache_file = binaryCacheFile_(vertex_code, fragment_code);
+    if (!cache_file.empty() && loadProgramBinary_(cache_file))
+    {
+        return;
+    }
+
+    unsigned int vertex_shader = Shader::compileVertexShader_(vertex_code);
+    unsigned int fragment_shader = Shader::compileFragmentShader_(fragment_code);
+
+    // create program
+    createProgram_(vertex_shader, fragment_shader, !cache_file.empty());
+
+    // cleanup
+    glDeleteShader(vertex_shader);
+    glDeleteShader(fragment_shader);
+
+    if (!cache_file.empty() && isLinked())
+    {
+        saveProgramBinary_(cache_file);
+    }
 }
 
-void Shader::createProgram_(unsigned int vertex_shader, unsigned int fragment_shader)
+void Shader::createProgram_(unsigned int vertex_shader, unsigned int fragment_shader, bool retrievable)
 {
     // link shaders
     ID_ = glCreateProgram();
+    if (retrievable)
+    {
+        glProgramParameteri(ID_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
     glAttachShader(ID_, vertex_shader);
     glAttachShader(ID_, fragment_shader);
     glLinkProgram(ID_);
@@ -141,6 +267,187 @@ void Shader::createProgram_(unsigned int vertex_shader, unsigned int fragment_sh
     if (!success) {
         glGetProgramInfoLog(ID_, 512, NULL, infoLog);
         std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+        return;
+    }
+
+    resolveUniforms_();
+}
+
+void Shader::resolveUniforms_()
+{
+    uniform_locations_.clear();
+
+    int n_uniforms = 0;
+    int max_length = 0;
+    glGetProgramiv(ID_, GL_ACTIVE_UNIFORMS, &n_uniforms);
+    glGetProgramiv(ID_, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+    std::string name(max_length > 0 ? max_length : 1, '\0');
+    for (int i = 0; i < n_uniforms; ++i)
+    {
+        int length = 0, size = 0;
+        GLenum type;
+        glGetActiveUniform(ID_, i, (GLsizei)name.size(), &length, &size, &type, &name[0]);
+        std::string uniform_name = name.substr(0, length);
+        // block members don't have locations
+        int location = glGetUniformLocation(ID_, uniform_name.c_str());
+        if (location < 0)
+        {
+            continue;
+        }
+        uniform_locations_[uniform_name] = location;
+        // arrays are reported as name[0]
+        std::size_t bracket = uniform_name.find("[0]");
+        if (bracket != std::string::npos && bracket + 3 == uniform_name.size())
+        {
+            uniform_locations_[uniform_name.substr(0, bracket)] = location;
+        }
+    }
+
+    const std::pair<const char*, UniformBlockBindings> blocks[] = {
+        { "LayeredCameras", LAYERED_CAMERAS_BINDING },
+        { "Camera", CAMERA_BINDING },
+        { "Transform", TRANSFORM_BINDING },
+        { "MaterialBlock", MATERIAL_BINDING },
+        { "Lights", LIGHTS_BINDING }
+    };
+    for (auto &&block : blocks)
+    {
+        unsigned int block_index = glGetUniformBlockIndex(ID_, block.first);
+        if (block_index != GL_INVALID_INDEX)
+        {
+            glUniformBlockBinding(ID_, block_index, block.second);
+        }
+    }
+}
+
+std::string Shader::binaryCacheFile_(const char* vertex_code, const char* fragment_code)
+{
+    std::string dir = getBinaryCacheDir();
+    if (dir.empty())
+    {
+        return "";
+    }
+
+    // core since 4.1, 3.3 contexts might still have GL_ARB_get_program_binary
+    if (glGetProgramBinary == nullptr || glProgramBinary == nullptr)
+    {
+        return "";
+    }
+    int n_formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &n_formats);
+    if (n_formats <= 0)
+    {
+        return "";
+    }
+
+    // a binary is only valid for the driver that made it
+    std::uint64_t hash = 14695981039346656037ull;
+    hashString(hash, vertex_code);
+    hashString(hash, fragment_code);
+    hashString(hash, (const char*)glGetString(GL_VENDOR));
+    hashString(hash, (const char*)glGetString(GL_RENDERER));
+    hashString(hash, (const char*)glGetString(GL_VERSION));
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)hash);
+    return dir + "/" + name;
+}
+
+bool Shader::loadProgramBinary_(const std::string& cache_file)
+{
+    std::ifstream file(cache_file, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+
+    char magic[4];
+    std::uint32_t format = 0;
+    std::uint32_t length = 0;
+    file.read(magic, sizeof(magic));
+    file.read((char*)&format, sizeof(format));
+    file.read((char*)&length, sizeof(length));
+    if (!file || !std::equal(magic, magic + 4, binary_cache_magic) || length == 0)
+    {
+        return false;
+    }
+    // glProgramBinary() would leave GL_INVALID_ENUM behind
+    if (!isSupportedBinaryFormat((GLenum)format))
+    {
+        return false;
+    }
+    std::vector<char> binary(length);
+    if (!file.read(binary.data(), length))
+    {
+        // cut short by a crash
+        return false;
+    }
+
+    ID_ = glCreateProgram();
+    glProgramBinary(ID_, (GLenum)format, binary.data(), (GLsizei)length);
+    if (!isLinked())
+    {
+        std::cout << "WARNING::SHADER::PROGRAM BINARY::Cached binary is rejected by the driver. Recompiling" << std::endl;
+        glDeleteProgram(ID_);
+        ID_ = 0;
+        return false;
+    }
+
+    resolveUniforms_();
+    return true;
+}
+
+void Shader::saveProgramBinary_(const std::string& cache_file) const
+{
+    int length = 0;
+    glGetProgramiv(ID_, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+    {
+        return;
+    }
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(ID_, length, &length, &format, binary.data());
+    if (length <= 0)
+    {
+        return;
+    }
+
+    makeDirs(cache_file.substr(0, cache_file.find_last_of('/')));
+
+    // other processes may read the file meanwhile: it's written aside and then renamed
+    std::ostringstream tmp_name;
+    tmp_name << cache_file << "." << std::hash<std::thread::id>()(std::this_thread::get_id())
+        << "." << std::chrono::steady_clock::now().time_since_epoch().count() << ".tmp";
+    {
+        std::ofstream file(tmp_name.str(), std::ios::binary);
+        std::uint32_t format_out = format;
+        std::uint32_t length_out = (std::uint32_t)length;
+        file.write(binary_cache_magic, sizeof(binary_cache_magic));
+        file.write((const char*)&format_out, sizeof(format_out));
+        file.write((const char*)&length_out, sizeof(length_out));
+        file.write(binary.data(), length);
+        if (!file)
+        {
+            // the same would happen to every program of the run
+            std::call_once(binary_cache_write_warning, [&cache_file]()
+            {
+                std::cout << "WARNING::SHADER::PROGRAM BINARY::Failed to write to the shader cache "
+                    << cache_file.substr(0, cache_file.find_last_of('/')) << ". Programs are compiled on every run" << std::endl;
+            });
+            file.close();
+            std::remove(tmp_name.str().c_str());
+            return;
+        }
+    }
+    if (std::rename(tmp_name.str().c_str(), cache_file.c_str()) != 0)
+    {
+        // rename() doesn't replace the file on Windows
+        std::remove(cache_file.c_str());
+        if (std::rename(tmp_name.str().c_str(), cache_file.c_str()) != 0)
+        {
+            std::remove(tmp_name.str().c_str());
+        }
     }
 }
 
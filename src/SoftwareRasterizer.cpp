@@ -0,0 +1,557 @@
+#include "../header/SoftwareRasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOFTWARE_RASTERIZER_SSE
+#include <emmintrin.h>
+#endif
+
+SoftwareRasterizer::SoftwareRasterizer(int width, int height, std::size_t n_threads)
+    : next_job_(0)
+{
+    setImageSize(width, height);
+
+    // the calling thread works too
+    for (std::size_t i = 1; i < n_threads; ++i)
+    {
+        workers_.emplace_back(&SoftwareRasterizer::workerLoop_, this);
+    }
+}
+
+SoftwareRasterizer::~SoftwareRasterizer()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    start_.notify_all();
+    for (auto &&worker : workers_)
+    {
+        worker.join();
+    }
+}
+
+void SoftwareRasterizer::setImageSize(int width, int height)
+{
+    width_ = width;
+    height_ = height;
+    tiles_x_ = (width_ + tile_size_ - 1) / tile_size_;
+    tiles_y_ = (height_ + tile_size_ - 1) / tile_size_;
+    tile_bins_.resize((std::size_t)tiles_x_ * tiles_y_);
+    depth_.resize((std::size_t)width_ * height_);
+}
+
+bool SoftwareRasterizer::isSupported(Shader::ShaderTypes shader_type)
+{
+    switch (shader_type)
+    {
+    case Shader::NOTEXTURE_SHADER:
+    case Shader::TEXTURE_SHADER:
+    case Shader::FACEIDX_SHADER:
+    case Shader::FLAT_SHADER:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void SoftwareRasterizer::setTexture(const unsigned char* data, int width, int height)
+{
+    texture_ = data;
+    texture_width_ = width;
+    texture_height_ = height;
+    // GL_UNPACK_ALIGNMENT is 4 when the texture is uploaded
+    texture_row_size_ = ((std::size_t)width * 3 + 3) & ~(std::size_t)3;
+}
+
+void SoftwareRasterizer::setGeometry(std::vector<Vertex> vertices, std::vector<unsigned int> indices)
+{
+    vertices_ = std::move(vertices);
+    indices_ = std::move(indices);
+    clip_vertices_.resize(vertices_.size());
+}
+
+void SoftwareRasterizer::render(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& eye_pos, unsigned char* color_out,
+    unsigned int* face_idx_out)
+{
+    eye_pos_ = eye_pos;
+
+    // same order of operations as in the vertex shaders
+    transformVertices_(projection * view);
+
+    std::size_t n_triangles = indices_.size() / 3;
+    chunk_triangles_.resize((n_triangles + setup_chunk_size_ - 1) / setup_chunk_size_);
+    parallelFor_(chunk_triangles_.size(), [this](std::size_t chunk)
+    {
+        setUpTriangles_(chunk, chunk_triangles_[chunk]);
+    });
+
+    binTriangles_();
+
+    parallelFor_(tile_bins_.size(), [this, color_out, face_idx_out](std::size_t tile)
+    {
+        rasterizeTile_(tile, color_out, face_idx_out);
+    });
+}
+
+void SoftwareRasterizer::transformVertices_(const glm::mat4& view_projection)
+{
+    std::size_t n_chunks = (vertices_.size() + setup_chunk_size_ - 1) / setup_chunk_size_;
+    parallelFor_(n_chunks, [this, &view_projection](std::size_t chunk)
+    {
+        std::size_t end = std::min(vertices_.size(), (chunk + 1) * setup_chunk_size_);
+        for (std::size_t i = chunk * setup_chunk_size_; i < end; ++i)
+        {
+            const Vertex& vertex = vertices_[i];
+            ClipVertex& out = clip_vertices_[i];
+            out.world = vertex.position;
+            out.normal = vertex.normal;
+            out.uv = vertex.uv;
+            out.clip = view_projection * glm::vec4(vertex.position, 1.0f);
+        }
+    });
+}
+
+void SoftwareRasterizer::setUpTriangles_(std::size_t chunk, std::vector<Triangle>& triangles) const
+{
+    triangles.clear();
+
+    std::size_t end = std::min(indices_.size() / 3, (chunk + 1) * setup_chunk_size_);
+    for (std::size_t face = chunk * setup_chunk_size_; face < end; ++face)
+    {
+        const unsigned int* idx = &indices_[face * 3];
+        ClipVertex vertices[3] = { clip_vertices_[idx[0]], clip_vertices_[idx[1]], clip_vertices_[idx[2]] };
+        // flat attributes come from the last vertex
+        const glm::vec3& flat_color = vertices_[idx[2]].color;
+        std::size_t first_new = triangles.size();
+
+        bool inside = true;
+        for (int i = 0; i < 3; ++i)
+        {
+            const glm::vec4& clip = vertices[i].clip;
+            inside = inside && clip.z >= -clip.w && clip.z <= clip.w;
+        }
+
+        if (inside)
+        {
+            Triangle triangle;
+            if (setUpTriangle_(vertices[0], vertices[1], vertices[2], flat_color, triangle))
+            {
+                triangles.push_back(triangle);
+            }
+        }
+        else
+        {
+            clipAndEmit_(vertices, flat_color, triangles);
+        }
+
+        // the pieces of the clipped triangle keep its id
+        for (std::size_t i = first_new; i < triangles.size(); ++i)
+        {
+            triangles[i].face_idx = (unsigned int)face;
+        }
+    }
+}
+
+void SoftwareRasterizer::clipAndEmit_(const ClipVertex* vertices, const glm::vec3& flat_color, std::vector<Triangle>& triangles) const
+{
+    // each plane adds at most one vertex
+    ClipVertex polygon[5], clipped[5];
+    std::size_t n_vertices = 3;
+    std::copy(vertices, vertices + 3, polygon);
+
+    for (int plane = 0; plane < 2; ++plane)
+    {
+        // near: z + w >= 0, far: w - z >= 0
+        float sign = plane == 0 ? 1.0f : -1.0f;
+        std::size_t n_clipped = 0;
+        for (std::size_t i = 0; i < n_vertices; ++i)
+        {
+            const ClipVertex& current = polygon[i];
+            const ClipVertex& next = polygon[(i + 1) % n_vertices];
+            float d_current = sign * current.clip.z + current.clip.w;
+            float d_next = sign * next.clip.z + next.clip.w;
+
+            if (d_current >= 0.0f)
+            {
+                clipped[n_clipped++] = current;
+            }
+            if ((d_current >= 0.0f) != (d_next >= 0.0f))
+            {
+                float t = d_current / (d_current - d_next);
+                ClipVertex& intersection = clipped[n_clipped++];
+                intersection.clip = glm::mix(current.clip, next.clip, t);
+                intersection.world = glm::mix(current.world, next.world, t);
+                intersection.normal = glm::mix(current.normal, next.normal, t);
+                intersection.uv = glm::mix(current.uv, next.uv, t);
+            }
+        }
+
+        n_vertices = n_clipped;
+        std::copy(clipped, clipped + n_clipped, polygon);
+        if (n_vertices < 3)
+        {
+            return;
+        }
+    }
+
+    for (std::size_t i = 1; i + 1 < n_vertices; ++i)
+    {
+        Triangle triangle;
+        if (setUpTriangle_(polygon[0], polygon[i], polygon[i + 1], flat_color, triangle))
+        {
+            triangles.push_back(triangle);
+        }
+    }
+}
+
+bool SoftwareRasterizer::setUpTriangle_(const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2,
+    const glm::vec3& flat_color, Triangle& triangle) const
+{
+    const ClipVertex* vertices[3] = { &v0, &v1, &v2 };
+    float x[3], y[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        const ClipVertex& vertex = *vertices[i];
+        float inv_w = 1.0f / vertex.clip.w;
+
+        // viewport transform
+        x[i] = (vertex.clip.x * inv_w + 1.0f) * 0.5f * width_;
+        y[i] = (vertex.clip.y * inv_w + 1.0f) * 0.5f * height_;
+        triangle.z[i] = vertex.clip.z * inv_w * 0.5f + 0.5f;
+        triangle.inv_w[i] = inv_w;
+
+        triangle.world[i] = vertex.world;
+        triangle.normal[i] = vertex.normal;
+        triangle.uv[i] = vertex.uv;
+    }
+
+    // GL_CULL_FACE with the default GL_BACK & GL_CCW; degenerate ones are dropped too
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (!(area > 0.0f))
+    {
+        return false;
+    }
+    triangle.inv_area = 1.0f / area;
+
+    // edge i is opposite to vertex i
+    for (int i = 0; i < 3; ++i)
+    {
+        int from = (i + 1) % 3;
+        int to = (i + 2) % 3;
+        triangle.a[i] = y[from] - y[to];
+        triangle.b[i] = x[to] - x[from];
+        triangle.c[i] = -(triangle.a[i] * x[from] + triangle.b[i] * y[from]);
+        triangle.top_left[i] = triangle.a[i] > 0.0f || (triangle.a[i] == 0.0f && triangle.b[i] < 0.0f);
+    }
+
+    triangle.min_x = std::max(0, (int)std::floor(std::min({ x[0], x[1], x[2] })));
+    triangle.min_y = std::max(0, (int)std::floor(std::min({ y[0], y[1], y[2] })));
+    triangle.max_x = std::min(width_ - 1, (int)std::ceil(std::max({ x[0], x[1], x[2] })));
+    triangle.max_y = std::min(height_ - 1, (int)std::ceil(std::max({ y[0], y[1], y[2] })));
+    if (triangle.min_x > triangle.max_x || triangle.min_y > triangle.max_y)
+    {
+        return false;
+    }
+
+    triangle.flat_color = flat_color;
+    return true;
+}
+
+void SoftwareRasterizer::binTriangles_()
+{
+    // submission order is kept -- it matters for the depth ties
+    triangles_.clear();
+    for (auto &&chunk : chunk_triangles_)
+    {
+        for (auto &&triangle : chunk)
+        {
+            triangles_.push_back(&triangle);
+        }
+    }
+
+    for (auto &&bin : tile_bins_)
+    {
+        bin.clear();
+    }
+    for (std::size_t i = 0; i < triangles_.size(); ++i)
+    {
+        const Triangle& triangle = *triangles_[i];
+        for (int ty = triangle.min_y / tile_size_; ty <= triangle.max_y / tile_size_; ++ty)
+        {
+            for (int tx = triangle.min_x / tile_size_; tx <= triangle.max_x / tile_size_; ++tx)
+            {
+                tile_bins_[(std::size_t)ty * tiles_x_ + tx].push_back((unsigned int)i);
+            }
+        }
+    }
+}
+
+void SoftwareRasterizer::rasterizeTile_(std::size_t tile, unsigned char* color_out, unsigned int* face_idx_out)
+{
+    int tile_min_x = (int)(tile % tiles_x_) * tile_size_;
+    int tile_min_y = (int)(tile / tiles_x_) * tile_size_;
+    int tile_max_x = std::min(width_, tile_min_x + tile_size_) - 1;
+    int tile_max_y = std::min(height_, tile_min_y + tile_size_) - 1;
+
+    // clear
+    for (int y = tile_min_y; y <= tile_max_y; ++y)
+    {
+        std::size_t row = (std::size_t)y * width_;
+        std::fill(depth_.begin() + row + tile_min_x, depth_.begin() + row + tile_max_x + 1, 1.0f);
+        std::fill(color_out + (row + tile_min_x) * 3, color_out + (row + tile_max_x + 1) * 3, (unsigned char)0);
+        if (face_idx_out != nullptr)
+        {
+            unsigned int background = Frame::background_face_idx;
+            std::fill(face_idx_out + row + tile_min_x, face_idx_out + row + tile_max_x + 1, background);
+        }
+    }
+
+    for (auto &&triangle_idx : tile_bins_[tile])
+    {
+        const Triangle& triangle = *triangles_[triangle_idx];
+        int min_x = std::max(tile_min_x, triangle.min_x);
+        int max_x = std::min(tile_max_x, triangle.max_x);
+        int min_y = std::max(tile_min_y, triangle.min_y);
+        int max_y = std::min(tile_max_y, triangle.max_y);
+
+#ifdef SOFTWARE_RASTERIZER_SSE
+        __m128 zero = _mm_setzero_ps();
+        __m128 lane_offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+        __m128 a[3], top_left[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            a[i] = _mm_set1_ps(triangle.a[i]);
+            top_left[i] = _mm_castsi128_ps(_mm_set1_epi32(triangle.top_left[i] ? -1 : 0));
+        }
+#endif
+
+        for (int y = min_y; y <= max_y; ++y)
+        {
+            float py = y + 0.5f;
+            float row_c[3];
+            for (int i = 0; i < 3; ++i)
+            {
+                row_c[i] = triangle.b[i] * py + triangle.c[i];
+            }
+
+            for (int x = min_x; x <= max_x; x += 4)
+            {
+                float e[3][4];
+                int coverage = 0;
+#ifdef SOFTWARE_RASTERIZER_SSE
+                __m128 px = _mm_add_ps(_mm_set1_ps((float)x), lane_offsets);
+                __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                for (int i = 0; i < 3; ++i)
+                {
+                    __m128 edge = _mm_add_ps(_mm_mul_ps(a[i], px), _mm_set1_ps(row_c[i]));
+                    __m128 on_edge = _mm_and_ps(_mm_cmpeq_ps(edge, zero), top_left[i]);
+                    inside = _mm_and_ps(inside, _mm_or_ps(_mm_cmpgt_ps(edge, zero), on_edge));
+                    _mm_storeu_ps(e[i], edge);
+                }
+                coverage = _mm_movemask_ps(inside);
+#else
+                for (int lane = 0; lane < 4; ++lane)
+                {
+                    float px = x + lane + 0.5f;
+                    bool inside = true;
+                    for (int i = 0; i < 3; ++i)
+                    {
+                        e[i][lane] = triangle.a[i] * px + row_c[i];
+                        inside = inside && (e[i][lane] > 0.0f || (e[i][lane] == 0.0f && triangle.top_left[i]));
+                    }
+                    coverage |= (int)inside << lane;
+                }
+#endif
+                // the last group might go past the bounding box
+                if (max_x - x < 3)
+                {
+                    coverage &= (1 << (max_x - x + 1)) - 1;
+                }
+
+                while (coverage)
+                {
+                    int lane = 0;
+                    while (!(coverage & (1 << lane))) ++lane;
+                    coverage &= ~(1 << lane);
+
+                    float l0 = e[0][lane] * triangle.inv_area;
+                    float l1 = e[1][lane] * triangle.inv_area;
+                    float l2 = e[2][lane] * triangle.inv_area;
+
+                    // depth is linear in the screen space
+                    float z = l0 * triangle.z[0] + l1 * triangle.z[1] + l2 * triangle.z[2];
+                    std::size_t pixel = (std::size_t)y * width_ + x + lane;
+                    if (z < depth_[pixel])  // GL_LESS
+                    {
+                        depth_[pixel] = z;
+                        shadePixel_(triangle, l0, l1, l2, color_out + pixel * 3);
+                        if (face_idx_out != nullptr)
+                        {
+                            face_idx_out[pixel] = triangle.face_idx;
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+void SoftwareRasterizer::shadePixel_(const Triangle& triangle, float l0, float l1, float l2, unsigned char* pixel) const
+{
+    glm::vec3 color;
+    switch (shader_type_)
+    {
+    case Shader::NOTEXTURE_SHADER:
+    case Shader::TEXTURE_SHADER:
+    {
+        // perspective-correct interpolation
+        float p0 = l0 * triangle.inv_w[0];
+        float p1 = l1 * triangle.inv_w[1];
+        float p2 = l2 * triangle.inv_w[2];
+        float norm = 1.0f / (p0 + p1 + p2);
+        p0 *= norm; p1 *= norm; p2 *= norm;
+
+        glm::vec3 frag_position = p0 * triangle.world[0] + p1 * triangle.world[1] + p2 * triangle.world[2];
+        glm::vec3 normal = p0 * triangle.normal[0] + p1 * triangle.normal[1] + p2 * triangle.normal[2];
+        color = phong_(glm::normalize(normal), frag_position);
+
+        if (shader_type_ == Shader::TEXTURE_SHADER)
+        {
+            glm::vec2 uv = p0 * triangle.uv[0] + p1 * triangle.uv[1] + p2 * triangle.uv[2];
+            color *= sampleTexture_(glm::vec2(uv.x, 1.0f - uv.y));
+        }
+        break;
+    }
+    default:
+        color = triangle.flat_color;
+        break;
+    }
+
+    // normalized fixed-point conversion, as for GL_RGB8
+    for (int i = 0; i < 3; ++i)
+    {
+        pixel[i] = (unsigned char)(glm::clamp(color[i], 0.0f, 1.0f) * 255.0f + 0.5f);
+    }
+}
+
+glm::vec3 SoftwareRasterizer::phong_(const glm::vec3& normal, const glm::vec3& frag_position) const
+{
+    // NoTextureFragmentShader.h, without the unused spot light
+    const Material& material = params_.material;
+    glm::vec3 view_dir = glm::normalize(eye_pos_ - frag_position);
+
+    auto components = [&material, &normal, &view_dir](const glm::vec3& light_dir,
+        const glm::vec3& ambient, const glm::vec3& diffuse, const glm::vec3& specular)
+    {
+        float diff_strength = std::max(glm::dot(normal, light_dir), 0.0f);
+        glm::vec3 reflect_dir = glm::reflect(-light_dir, normal);
+        float specular_strength = std::pow(std::max(glm::dot(view_dir, reflect_dir), 0.0f), material.shininess);
+
+        return diff_strength * diffuse * material.diffuse
+            + specular_strength * specular * material.specular
+            + ambient * material.diffuse;
+    };
+
+    const DirectionalLight& directional = params_.directional_light;
+    glm::vec3 out_color = components(glm::normalize(-directional.direction),
+        directional.ambient, directional.diffuse, directional.specular);
+
+    for (std::size_t i = 0; i < ShadingParams::kPointLights; ++i)
+    {
+        const PointLight& light = params_.point_lights[i];
+        glm::vec3 light_dir = glm::normalize(light.position - frag_position);
+        float dist = glm::length(light.position - frag_position);
+
+        float attenuation = 1.0f / (light.attenuation_constant
+            + light.attenuation_linear * dist
+            + light.attenuation_quadratic * dist * dist);
+
+        out_color += attenuation * components(light_dir, light.ambient, light.diffuse, light.specular);
+    }
+
+    return out_color;
+}
+
+glm::vec3 SoftwareRasterizer::sampleTexture_(glm::vec2 uv) const
+{
+    // GL_NEAREST with GL_CLAMP_TO_BORDER
+    static const glm::vec3 border_color(1.0f, 1.0f, 0.0f);
+    if (texture_ == nullptr)
+    {
+        return border_color;
+    }
+
+    float s = std::floor(uv.x * texture_width_);
+    float t = std::floor(uv.y * texture_height_);
+    if (!(s >= 0.0f && s < texture_width_ && t >= 0.0f && t < texture_height_))
+    {
+        return border_color;
+    }
+
+    const unsigned char* texel = texture_ + (std::size_t)t * texture_row_size_ + (std::size_t)s * 3;
+    return glm::vec3(texel[0], texel[1], texel[2]) / 255.0f;
+}
+
+void SoftwareRasterizer::parallelFor_(std::size_t n_jobs, const std::function<void(std::size_t)>& job)
+{
+    if (workers_.empty() || n_jobs < 2)
+    {
+        for (std::size_t i = 0; i < n_jobs; ++i)
+        {
+            job(i);
+        }
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        job_ = &job;
+        n_jobs_ = n_jobs;
+        next_job_ = 0;
+        busy_workers_ = workers_.size();
+        ++generation_;
+    }
+    start_.notify_all();
+
+    runJobs_();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return busy_workers_ == 0; });
+    job_ = nullptr;
+}
+
+void SoftwareRasterizer::runJobs_()
+{
+    for (std::size_t i = next_job_++; i < n_jobs_; i = next_job_++)
+    {
+        (*job_)(i);
+    }
+}
+
+void SoftwareRasterizer::workerLoop_()
+{
+    std::size_t seen_generation = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            start_.wait(lock, [this, seen_generation] { return stop_ || generation_ != seen_generation; });
+            if (stop_)
+            {
+                return;
+            }
+            seen_generation = generation_;
+        }
+
+        runJobs_();
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            --busy_workers_;
+        }
+        done_.notify_all();
+    }
+}